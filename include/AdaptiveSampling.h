@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "Framebuffer.h"
+
+// Decides how many samples each pixel takes in the next round of rendering
+struct SampleSchedule {
+    virtual ~SampleSchedule() = default;
+
+    // fill samples to add for each pixel, false when rendering is done
+    virtual bool next_round(const Framebuffer &stats, std::vector<uint32_t> &alloc) = 0;
+};
+
+// Splits budget of spp * pixels samples between pixels in rounds.
+// First round gives every pixel a few samples, next ones spend half of the
+// remaining budget proportionally to pixel error. Pixels with error below
+// threshold are converged and get no more samples.
+// Threshold 0 disables adaptivity: single round up to spp samples per pixel.
+// Samples already in frame (resumed render, guiding training) are part of budget.
+struct SampleAllocator : SampleSchedule {
+    SampleAllocator(const Framebuffer &frame, uint32_t spp, float threshold);
+
+    bool next_round(const Framebuffer &stats, std::vector<uint32_t> &alloc) override;
+
+private:
+    size_t pixels;
+    uint32_t spp;
+    float threshold;
+    size_t remaining;
+    uint32_t max_per_pixel;
+    int round = 0;
+};
+
+// Progressive rendering: passes of pass_spp samples over the whole image
+// until mean pixel error drops to target_error or every pixel has max_spp
+// samples. Wall-clock deadline is enforced by the renderer.
+// Pixels with error below threshold are skipped, as in SampleAllocator.
+struct ProgressiveSchedule : SampleSchedule {
+    ProgressiveSchedule(size_t pixels, uint32_t pass_spp, uint32_t max_spp, float target_error, float threshold);
+
+    bool next_round(const Framebuffer &stats, std::vector<uint32_t> &alloc) override;
+
+    // mean relative error over pixels before last pass
+    float mean_error = INFINITY;
+
+private:
+    size_t pixels;
+    uint32_t pass_spp;
+    uint32_t max_spp;
+    float target_error;
+    float threshold;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Walker's alias method: O(1) sampling of discrete distribution
+struct AliasTable {
+    std::vector<float> prob;
+    std::vector<uint32_t> alias;
+
+    AliasTable() {}
+    // weights doesn't have to be normalized
+    AliasTable(const std::vector<float> &weights);
+
+    // u in [0, 1), fraction of scaled u is reused to choose between bin and its alias
+    uint32_t sample(float u) const {
+        float x = u * prob.size();
+        uint32_t i = std::min(uint32_t(x), uint32_t(prob.size() - 1));
+        return x - i < prob[i] ? i : alias[i];
+    }
+};
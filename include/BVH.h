@@ -3,10 +3,13 @@
 #include "Primitives/Ray.h"
 #include "Primitives/AABB.h"
 #include "Object.h"
+#include "Parallel.h"
 
 #include <vector>
 #include <optional>
 #include <cassert>
+#include <numeric>
+#include <algorithm>
 
 struct Node {
     ssize_t start;
@@ -28,8 +31,10 @@ using objsIt = std::vector<T>::const_iterator;
 public:
     BVH() {};
     BVH(F ini, objsIt begin, objsIt end) : ini(ini), objs(begin, end) {
-        tree.reserve(objs.end() - objs.begin()); // prevent reallocations to make dirty hacks in build work
-        root_node = build_bvh(objs.begin(), objs.end());
+        tree.reserve(2 * objs.size());
+        run_tasks([&] {
+            root_node = build_bvh(objs.begin(), objs.end(), tree);
+        });
         std::cerr << "BVH statistics:\n";
         std::cerr << "Total nodes: " << tree.size() << '\n';
         auto it = std::max_element(tree.begin(), tree.end(),
@@ -47,7 +52,23 @@ public:
         return get_intersect_(root_node, ray, early_out);
     }
 
+    // visibility query: true if any object intersects ray closer than t_max
+    bool occluded(const Ray& ray, float t_max) const {
+        return occluded_(root_node, ray, t_max);
+    }
+
 private:
+    bool occluded_(ssize_t node_idx, const Ray& ray, float t_max) const {
+        if (node_idx == -1) return false;
+        const Node &node = tree[node_idx];
+        if (node.aabb.get_intersect(ray) > t_max) return false;
+        for (auto it = objs.begin() + node.start; it != objs.begin() + node.start + node.len; ++it) {
+            float t = (Geom() (*it))->get_intersect(ray).t;
+            if (t >= 0 && t < t_max) return true;
+        }
+        return occluded_(node.left, ray, t_max) || occluded_(node.right, ray, t_max);
+    }
+
     F get_intersect_(ssize_t node_idx, const Ray& ray, bool early_out) const {
         if (node_idx == -1) return ini;
         const Node &node = tree[node_idx];
@@ -74,7 +95,10 @@ private:
         return res;
     }
 
-    ssize_t build_bvh(std::vector<T>::iterator begin, std::vector<T>::iterator end) {
+    // nodes of subtree are appended to out in post-order. Large subtrees are
+    // built as tasks into own vectors and spliced left first, so layout is the
+    // same as of serial build on any thread count.
+    ssize_t build_bvh(std::vector<T>::iterator begin, std::vector<T>::iterator end, std::vector<Node> &out) {
         if (begin == end) return -1;
         AABB node_aabb = std::transform_reduce(begin + 1, end,
             (Geom() (*begin))->get_aabb(),
@@ -85,8 +109,8 @@ private:
         );
         if (end - begin <= term_size) {
             /* std::cerr << "Create term node with " << end - begin << " objects\n"; */
-            tree.push_back({begin - objs.begin(), end - begin, -1, -1, node_aabb});
-            return tree.size() - 1;
+            out.push_back({begin - objs.begin(), end - begin, -1, -1, node_aabb});
+            return out.size() - 1;
         }
 
         auto pivot = end;
@@ -102,16 +126,38 @@ private:
             });
 
             if (pivot == begin || pivot == end) {
-                tree.push_back({begin - objs.begin(), end - begin, -1, -1, node_aabb});
-                return tree.size() - 1;
+                out.push_back({begin - objs.begin(), end - begin, -1, -1, node_aabb});
+                return out.size() - 1;
             }
         }
 
         /* std::cerr << "Create split node: " << pivot - begin << " in left child, and " << end - pivot << " in right child\n"; */
-        ssize_t L = build_bvh(begin, pivot);
-        ssize_t R = build_bvh(pivot, end);
-        tree.push_back({begin - objs.begin(), 0, L, R, tree[L].aabb | tree[R].aabb});
-        return tree.size() - 1;
+        ssize_t L, R;
+        if (end - begin >= task_size) {
+            std::vector<Node> left, right;
+#pragma omp task shared(left, L)
+            L = build_bvh(begin, pivot, left);
+            R = build_bvh(pivot, end, right);
+#pragma omp taskwait
+            L = splice(out, left, L);
+            R = splice(out, right, R);
+        } else {
+            L = build_bvh(begin, pivot, out);
+            R = build_bvh(pivot, end, out);
+        }
+        out.push_back({begin - objs.begin(), 0, L, R, out[L].aabb | out[R].aabb});
+        return out.size() - 1;
+    }
+
+    // append subtree with node indices shifted, returns new index of root
+    static ssize_t splice(std::vector<Node> &out, const std::vector<Node> &sub, ssize_t root) {
+        ssize_t offset = out.size();
+        for (Node node : sub) {
+            if (node.left != -1) node.left += offset;
+            if (node.right != -1) node.right += offset;
+            out.push_back(node);
+        }
+        return root + offset;
     }
 
 private:
@@ -120,6 +166,8 @@ private:
     ssize_t root_node;
     F ini;
     static const size_t term_size = 1;
+    // smaller subtrees are not worth a task
+    static const ssize_t task_size = 4096;
 };
 
 }
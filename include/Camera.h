@@ -21,8 +21,16 @@ struct Camera {
         fov_x = 2 * atanf(w * tanf(fov_y/2) / h);
     }
 
+    // orientation looking from position to target, up is only a hint
+    void look_at(const Vec3<float> &position_, const Vec3<float> &target, const Vec3<float> &up_hint) {
+        position = position_;
+        forward = (target - position).norm();
+        right = (forward ^ up_hint).norm();
+        up = right ^ forward;
+    }
+
     // x, y in [-1, 1]
-    Ray raycast(float x, float y) {
+    Ray raycast(float x, float y) const {
         Vec3<float> v = {x * tanf(fov_x / 2), y * tanf(fov_y / 2), 1};
         Vec3<float> v_rotated = forward * v.z + up * v.y + right * v.x;
         return Ray {position, v_rotated.norm()};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "Framebuffer.h"
+#include "SceneBuilder.h"
+
+// Render state that survives restart of process: accumulated radiance and
+// per-pixel sample counts. Samplers are counter based, so sample count of
+// pixel is its whole sampler state, seed and sequence are kept to check
+// that resumed render continues the same sequences, path depths and guiding
+// to check that it continues the same estimator. First sample index is
+// kept too, so checkpoints of worker processes double as their partial frames.
+
+// Write frame to path atomically: temporary file, fsync, rename
+void save_checkpoint(const std::string &path, const Framebuffer &frame, const Setup &setup);
+
+// Read frame saved for same resolution, sequence, seed, depths and guiding, throws logic_error otherwise
+Framebuffer load_checkpoint(const std::string &path, const Setup &setup);
+
+// Read frame of any checkpoint, resolution, sequence, seed, first sample,
+// depths and guiding are taken from file into setup
+Framebuffer load_partial(const std::string &path, Setup &setup);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Primitives/Vec3x.h"
+
+// Stateless counter-based random numbers. Value number `counter` of stream `key`
+// is a pure function of both, so streams seeded by (pixel, sample) can be
+// evaluated in any order, by any thread, or several lanes at once.
+
+template<int N>
+using Uintx = stdx::fixed_size_simd<uint32_t, N>;
+
+// PCG output permutation (RXS-M-XS), for scalars and simd lanes
+template<typename T>
+inline T pcg_hash(T v) {
+    T state = v * 747796405u + 2891336453u;
+    T word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+struct CounterRng {
+    uint32_t key;
+    uint32_t counter; // current dimension
+
+    CounterRng() : key(0), counter(0) {}
+    CounterRng(uint32_t pixel, uint32_t sample, uint32_t dimension = 0)
+        : key(pcg_hash(pixel + pcg_hash(sample))), counter(dimension) {}
+
+    uint32_t next() {
+        return pcg_hash(key + pcg_hash(counter++));
+    }
+
+    // uniform in [0, 1)
+    float next_float() {
+        return (next() >> 8) * 0x1p-24f;
+    }
+
+    // N consecutive dimensions at once
+    template<int N>
+    Floatx<N> next_floats() {
+        Uintx<N> c([this] (auto i) { return counter + uint32_t(i); });
+        counter += N;
+        Uintx<N> v = pcg_hash(Uintx<N>(key) + pcg_hash(c));
+        return stdx::static_simd_cast<Floatx<N>>(v >> 8) * 0x1p-24f;
+    }
+};
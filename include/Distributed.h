@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Framebuffer.h"
+
+// Render split across processes: every worker takes its own range of sample
+// indices in all pixels and writes accumulation as checkpoint (Checkpoint.h).
+// Samplers are counter based, so merged partial frames hold exactly the
+// samples one process would take, only summed in different order.
+
+struct SampleRange {
+    uint32_t first, count;
+};
+
+// Split samples into parts of nearly equal count, part i starts reserve times
+// the counts of previous parts after 0, room for adaptive pixels taking more
+std::vector<SampleRange> split_samples(uint32_t samples, int parts, uint32_t reserve = 1);
+
+// Start this executable once per argument list, share threads of this process
+// between them and wait for all, throws logic_error if any worker fails
+void run_workers(const std::vector<std::vector<std::string>> &args, int threads);
+
+// Sum of partial frames of one render, throws logic_error if they differ in
+// resolution, sampler, seed, depths or guiding or their sample ranges overlap
+Framebuffer merge_partials(const std::vector<std::string> &paths);
@@ -4,30 +4,28 @@
 #include "Primitives/Ray.h"
 #include "Primitives/Intersection.h"
 #include "Object/Geometry.h"
-#include "Rnd.h"
+#include "Sampler.h"
+#include "AliasTable.h"
 
 #include <math.h>
 #include <algorithm>
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <optional>
 
 struct Distribution {
-    mutable Rnd *rnd;
-
-    Distribution() : rnd(Rnd::getRnd()) {}
+    Distribution() {}
     virtual ~Distribution() {}
-    virtual Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n) const = 0;
+    virtual Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n, Sampler &sampler) const = 0;
     virtual float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const = 0;
 };
 
-#include "BVH.h"
-
 // Not used now
 struct UniformDistribution : public Distribution {
     UniformDistribution();
     ~UniformDistribution();
-    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n) const;
+    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n, Sampler &sampler) const;
     float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const;
 };
 
@@ -35,91 +33,49 @@ struct UniformDistribution : public Distribution {
 struct CosineDistribution : public Distribution {
     CosineDistribution();
     ~CosineDistribution();
-    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n) const;
+    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n, Sampler &sampler) const;
     float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const;
 };
 
 
-struct LightDistribution : public Distribution {
-public:
-    std::shared_ptr<Geometry> geometry;
-    LightDistribution(std::shared_ptr<Geometry> geom) : geometry(geom), Distribution() {}
-    ~LightDistribution() {}
-
-    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n) const {
-        Vec3<float> x = geometry->position + geometry->rotation * sample_();
-        return (x - pos).norm();
-    }
+// Entry of flat emissive triangle table, all fields in world cords
+struct EmissiveTriangle {
+    Vec3<float> v0, e1, e2; // vertex and two edges
+    Vec3<float> normal;
+    float area;
+    Vec3<float> emission;
+    float power;
+    float select_pdf; // probability to be chosen, proportional to power
 
-    // angle pdf
-    float pdf(const Ray &r) const {
-        float res = 0;
-        Intersection obj_inter = geometry->get_intersect(r);
-        if (obj_inter.t < 0) return 0;
-        float tmp = pdf_(-geometry->rotation * (r.reveal(obj_inter.t) - geometry->position));
-        if (tmp <= 1e-5) {
-            throw std::logic_error("zero probability density by point");
-        }
-        float angle_k = abs(obj_inter.normal % r.v);
-        if (angle_k <= 1e-4) {
-            angle_k = 1e-4;
-        }
-        return tmp * obj_inter.t * obj_inter.t / angle_k;
-    }
+    EmissiveTriangle(const Triangle &tr, const Vec3<float> &emission);
 
-    float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const {
-        return pdf({pos, d});
+    // solid angle pdf to sample point at distance t in direction d, selection included
+    float pdf(const Vec3<float> &d, float t) const {
+        float angle_k = std::max(fabsf(normal % d), 1e-4f);
+        return select_pdf * t * t / (area * angle_k);
     }
-
-private:
-    // return sample from geom in local cords
-    virtual Vec3<float> sample_() const = 0;
-    // return geometry point pdf
-    virtual float pdf_(const Vec3<float> &pos) const = 0;
 };
 
-
-struct TriangleDistribution : public LightDistribution {
-    std::shared_ptr<Triangle> tr;
-    TriangleDistribution(std::shared_ptr<Triangle> tr);
-    ~TriangleDistribution();
-    Vec3<float> sample_() const;
-    float pdf_(const Vec3<float> &pos) const;
+struct LightSample {
+    Vec3<float> dir;
+    float t; // distance to sampled point
+    Vec3<float> emission;
+    float pdf; // solid angle pdf, light selection included
 };
 
-namespace BVH_light {
-using T = std::shared_ptr<LightDistribution>;
-struct Map {
-    Map (const Ray &r) : r(r) {};
-    float operator() (const T& dist) const {
-        return dist->pdf(r);
-    }
-    const Ray r;
-};
+// Union of all scene lights. Light is chosen from the flat table in O(1)
+// with probability proportional to its power, then a point on it uniformly.
+struct LightsDistribution {
+    std::vector<EmissiveTriangle> lights;
+    AliasTable alias;
 
-struct Geom {
-    std::shared_ptr<Geometry> operator() (const T &a) const {
-        return a->geometry;
-    }
-};
+    LightsDistribution(std::vector<EmissiveTriangle> &&lights);
 
-struct EarlyOut {
-    bool operator() (const float &res, float inter_t) const {
-        return false;
+    // pdf of sampling point at distance t along d on light found by closest hit
+    float pdf(int32_t light_id, const Vec3<float> &d, float t) const {
+        return lights[light_id].pdf(d, t);
     }
-};
 
-using BVH = RawBVH::BVH<T, float, Map, std::plus<float>, Geom, EarlyOut>;
-
-} // namespace BVH_light
-
-struct MixedDistribution : public Distribution {
-    BVH_light::BVH bvh;
-    std::vector<std::shared_ptr<LightDistribution>> dists;
-    CosineDistribution cosine;
-
-    MixedDistribution(std::vector<std::shared_ptr<LightDistribution>> &&dists);
-    ~MixedDistribution();
-    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n) const;
-    float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const;
+    // sample point on light for next event estimation
+    std::optional<LightSample> sample_light(const Vec3<float> &pos, Sampler &sampler) const;
 };
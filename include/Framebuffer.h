@@ -0,0 +1,143 @@
+#pragma once
+
+#include <vector>
+#include <new>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "Primitives/Vec3.h"
+#include "Tiles.h"
+#include "Parallel.h"
+
+// Running estimate of one pixel: linear HDR radiance sum and sample count
+struct PixelStats {
+    Vec3<float> sum = Vec3<float>(0);
+    // running mean and M2 of luminance, Welford
+    float lum_mean = 0;
+    float lum_m2 = 0;
+    uint32_t count = 0;
+
+    void add(const Vec3<float> &radiance) {
+        sum = sum + radiance;
+        float lum = luminance(radiance);
+        count++;
+        float delta = lum - lum_mean;
+        lum_mean += delta / count;
+        lum_m2 += delta * (lum - lum_mean);
+    }
+
+    // combine estimates of disjoint sample sets, Chan et al. pairwise update
+    void merge(const PixelStats &other) {
+        if (other.count == 0) return;
+        uint32_t n = count + other.count;
+        float delta = other.lum_mean - lum_mean;
+        sum = sum + other.sum;
+        lum_mean += delta * other.count / n;
+        lum_m2 += other.lum_m2 + delta * delta * (float(count) * other.count / n);
+        count = n;
+    }
+
+    Vec3<float> mean() const {
+        return count ? sum / count : Vec3<float>(0);
+    }
+
+    // relative standard error of mean luminance, dark pixels are measured against 0.1
+    float error() const {
+        if (count < 2) return INFINITY;
+        float variance = lum_m2 / (count - 1);
+        return sqrtf(variance / count) / (lum_mean + 0.1f);
+    }
+};
+
+template<typename T, size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+    template<typename U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T *p, size_t) {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+    bool operator==(const AlignedAllocator&) const { return true; }
+    bool operator!=(const AlignedAllocator&) const { return false; }
+};
+
+const size_t cache_line = 64;
+
+// Tile of framebuffer addressed in image coordinates
+struct TileView {
+    PixelStats *origin;
+    size_t stride;
+    Tile tile;
+
+    PixelStats &at(uint16_t x, uint16_t y) const {
+        return origin[(y - tile.y0) * stride + x - tile.x0];
+    }
+};
+
+// Linear accumulation buffer of whole image in one allocation. Rows start
+// on cache line, so tiles with width multiple of 8 never share a line and
+// threads write them through views without false sharing.
+// Tonemapping is a separate stage, see Tonemap.h.
+struct Framebuffer {
+    uint16_t width = 0, height = 0;
+    size_t stride = 0; // pixels per padded row
+    std::vector<PixelStats, AlignedAllocator<PixelStats, cache_line>> pixels;
+
+    Framebuffer() = default;
+    Framebuffer(uint16_t width, uint16_t height) : width(width), height(height) {
+        // smallest row length that is whole number of cache lines
+        size_t step = 1;
+        while (step * sizeof(PixelStats) % cache_line) step++;
+        stride = (width + step - 1) / step * step;
+        // first touch: before pixels are constructed, every thread writes the
+        // storage of tiles it owns in TileQueue, so with pinned threads pages
+        // of frame are on node that renders them
+        pixels.reserve(stride * height);
+        char *storage = reinterpret_cast<char*>(pixels.data());
+        std::vector<Tile> tiles = make_tiles(width, height);
+#pragma omp parallel
+        {
+            int threads = num_threads(), t = thread_num();
+            size_t end = TileQueue::range_begin(tiles.size(), threads, t + 1);
+            for (size_t k = TileQueue::range_begin(tiles.size(), threads, t); k < end; ++k) {
+                const Tile &tile = tiles[k];
+                // row padding goes with the last tile of row
+                size_t x1 = tile.x1 == width ? stride : tile.x1;
+                for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                    std::memset(storage + (y * stride + tile.x0) * sizeof(PixelStats), 0,
+                                (x1 - tile.x0) * sizeof(PixelStats));
+                }
+            }
+        }
+        // placed pages stay where they are, construction does not depend on team
+        pixels.resize(stride * height);
+    }
+
+    PixelStats &at(uint16_t x, uint16_t y) {
+        return pixels[y * stride + x];
+    }
+    const PixelStats &at(uint16_t x, uint16_t y) const {
+        return pixels[y * stride + x];
+    }
+
+    // pixel by unpadded index y * width + x
+    const PixelStats &operator[](size_t i) const {
+        return at(i % width, i / width);
+    }
+
+    size_t size() const {
+        return size_t(width) * height;
+    }
+
+    TileView view(const Tile &tile) {
+        return {&at(tile.x0, tile.y0), stride, tile};
+    }
+};
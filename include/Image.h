@@ -8,20 +8,20 @@
 
 #include "Primitives/Vec3.h"
 
+// 8-bit rgb display image
 struct Image {
     uint16_t width, height;
     std::vector<uint8_t> pixels;
 
-    Image(const std::vector<std::vector<Vec3<float>>> &img) : height(img.size()), width(img[0].size()) {
-        pixels.reserve(width * height * 3);
-        for (auto &row : img) {
-            for (auto &pixel : row) {
-                pixels.emplace_back(round(255 * pixel.x));
-                pixels.emplace_back(round(255 * pixel.y));
-                pixels.emplace_back(round(255 * pixel.z));
-            }
-        }
-    };
+    Image(uint16_t width, uint16_t height) : width(width), height(height), pixels(size_t(width) * height * 3) {}
+
+    // color is display referred, in [0, 1]
+    void set(uint16_t x, uint16_t y, const Vec3<float> &color) {
+        uint8_t *p = &pixels[(size_t(y) * width + x) * 3];
+        p[0] = round(255 * color.x);
+        p[1] = round(255 * color.y);
+        p[2] = round(255 * color.z);
+    }
 
     void write_ppm(std::ofstream os) {
         os << "P6\n";
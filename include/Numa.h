@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+// NUMA placement of render threads and scene memory, Linux only: topology is
+// read from /sys/devices/system/node, everything is a no-op on one node.
+struct NumaTopology {
+    struct Node {
+        int id;
+        std::vector<int> cpus;
+    };
+    std::vector<Node> nodes; // nodes with cpus
+
+    // single node with all cpus if /sys does not describe nodes
+    static NumaTopology detect();
+};
+
+// Pin threads of OpenMP pool to nodes in blocks: thread t runs on cpus of node
+// t * nodes / threads. TileQueue gives consecutive threads neighbouring Morton
+// ranges, so every node works on compact part of image.
+void pin_threads(const NumaTopology &topology);
+
+// Spread pages of following allocations round robin over all nodes, so shared
+// read-only data (triangles, BVH) is not all remote for other nodes
+void interleave_memory(const NumaTopology &topology);
+
+// Back to first touch placement on calling thread and all threads of OpenMP pool
+void reset_memory_policy();
@@ -4,8 +4,10 @@
 #include "Object/Geometry.h"
 
 #include <memory>
+#include <cstdint>
 
 struct Object {
     std::shared_ptr<Material> material;
     std::shared_ptr<Geometry> geometry;
+    int32_t light_id = -1; // entry in scene light table, -1 if object is not a light
 };
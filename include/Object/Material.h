@@ -4,31 +4,42 @@
 #include "Primitives/Intersection.h"
 #include "Primitives/Ray.h"
 #include "Distribution.h"
+#include "Sampler.h"
 
-#include <functional>
+#include <optional>
 #include <memory>
 
+// Result of scattering an incoming ray on surface:
+// outgoing radiance = emission + weight * (radiance along ray)
+struct Scatter {
+    Vec3<float> emission;
+    Vec3<float> weight; // bsdf * cos / pdf
+    std::optional<Ray> ray; // nullopt if path is terminated on this surface
+    float pdf = 0; // pdf of sampled direction, 0 for delta distributions
+};
+
 struct Material {
     Vec3<float> color;
     Vec3<float> emission;
-    virtual Vec3<float> sample(Ray w_in, Intersection i, const Distribution& dist,
-                                    const std::function<Vec3<float>(const Ray&)> &raycast) = 0;
+    virtual Scatter sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler) = 0;
+    // bsdf * cos for given outgoing direction, zero for delta distributions
+    virtual Vec3<float> eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const = 0;
 };
 
 struct Diffuse : public Material {
-    Vec3<float> sample(Ray w_in, Intersection i, const Distribution& dist,
-                            const std::function<Vec3<float>(const Ray&)> &raycast);
+    Scatter sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler);
+    Vec3<float> eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const;
 };
 
 struct Metallic : public Material {
-    Vec3<float> sample(Ray w_in, Intersection i, const Distribution& dist,
-                            const std::function<Vec3<float>(const Ray&)> &raycast);
+    Scatter sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler);
+    Vec3<float> eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const;
 };
 
 struct Dielectric : public Material {
     float ior;
-    Vec3<float> sample(Ray w_in, Intersection i, const Distribution& dist,
-                            const std::function<Vec3<float>(const Ray&)> &raycast);
+    Scatter sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler);
+    Vec3<float> eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const;
 private:
     float get_reflectness(float cos_phi1);
 };
@@ -0,0 +1,50 @@
+#pragma once
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Thin wrappers, so code compiles with and without OpenMP
+inline int thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// size of the current team, 1 outside of parallel region
+inline int num_threads() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+inline int max_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Fork-join entry point shared by all phases: f runs on one thread and the
+// OpenMP tasks it spawns are taken by idle threads of the team. Called from
+// inside a parallel region it joins that team, so nested phases compose
+// instead of oversubscribing cores.
+template<class F>
+void run_tasks(F &&f) {
+#ifdef _OPENMP
+    if (omp_in_parallel()) {
+        f();
+        return;
+    }
+#pragma omp parallel
+#pragma omp single
+    f();
+#else
+    f();
+#endif
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "Primitives/Vec3.h"
+#include "Primitives/AABB.h"
+#include "Distribution.h"
+#include "Sampler.h"
+
+// Online learned incident radiance, "Practical Path Guiding for Efficient
+// Light-Transport Simulation", Müller et al. 2017.
+// Binary tree over scene space, every leaf holds quadtree over directions.
+
+// Incident radiance sample: irradiance estimate arriving along dir at pos
+struct GuideRecord {
+    Vec3<float> pos;
+    Vec3<float> dir;
+    float value; // luminance of incident radiance / pdf of dir
+};
+
+// Quadtree over square of cylindrical coords (cos theta, phi), the mapping
+// is area preserving, so solid angle pdf is square pdf / 4pi
+struct DTree {
+    struct Node {
+        std::array<float, 4> sum = {0, 0, 0, 0};
+        std::array<uint32_t, 4> child = {0, 0, 0, 0}; // 0 for leaf quadrant
+    };
+    std::vector<Node> nodes = {Node()};
+    uint32_t samples = 0;
+
+    float total() const {
+        auto &s = nodes[0].sum;
+        return s[0] + s[1] + s[2] + s[3];
+    }
+
+    void record(const Vec3<float> &d, float value);
+
+    // solid angle pdf of direction, tree must have positive total
+    float pdf(const Vec3<float> &d) const;
+    Vec3<float> sample(float u1, float u2) const;
+
+    // empty tree subdivided where this one has more than threshold of energy
+    DTree refined(float threshold, int max_depth) const;
+};
+
+struct GuidingField {
+    explicit GuidingField(const AABB &bounds);
+
+    // leaf distribution used for sampling at pos, nullptr if nothing is learned there yet
+    const DTree *lookup(const Vec3<float> &pos) const;
+
+    void record(const std::vector<GuideRecord> &records);
+
+    // end of training iteration with 2^iteration spp: split crowded spatial
+    // leaves, switch sampling to collected data and restart collection
+    void refine(int iteration);
+
+private:
+    struct SNode {
+        uint32_t child = 0; // first of two children, 0 for leaf
+        uint32_t leaf = 0;
+        int axis = 0; // split axis, cycles with depth
+    };
+
+    struct Leaf {
+        DTree sampling, building;
+    };
+
+    AABB bounds;
+    std::vector<SNode> nodes;
+    std::vector<Leaf> leaves;
+
+    uint32_t find(const Vec3<float> &pos) const;
+    void split(uint32_t node, uint32_t threshold);
+};
+
+// Diffuse scattering: cosine lobe mixed with learned incident radiance,
+// pdf is the pdf of the mixture, so bsdf/light MIS stays correct
+struct GuidedDistribution : public Distribution {
+    const GuidingField &field;
+    float bsdf_fraction;
+
+    GuidedDistribution(const GuidingField &field, float bsdf_fraction = 0.5);
+    ~GuidedDistribution();
+    Vec3<float> sample(const Vec3<float> &pos, const Vec3<float> &n, Sampler &sampler) const;
+    float pdf(const Vec3<float> &pos, const Vec3<float> &n, const Vec3<float> &d) const;
+};
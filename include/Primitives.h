@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Primitives/Vec3.h"
+#include "Primitives/Vec3x.h"
 #include "Primitives/Ray.h"
 #include "Primitives/Intersection.h"
 #include "Primitives/Quaternion.h"
@@ -54,15 +54,15 @@ struct Vec3 {
         return sqrt(x * x + y * y + z * z);
     }
     Vec3<T> norm() const {
-        return (*this) * (1.0 / len());
+        return (*this) * (T(1) / len());
     }
 
     T min() const {
-        return std::min({x, y, z});
+        return std::min(x, std::min(y, z));
     }
 
     T max() const {
-        return std::max({x, y, z});
+        return std::max(x, std::max(y, z));
     }
 
     Vec3<T> maj() const {
@@ -102,3 +102,8 @@ template<typename T>
 Vec3<T> pow(const Vec3<T> &v, float p) {
     return { std::pow(v.x, p), std::pow(v.y, p), std::pow(v.z, p) };
 }
+
+// Rec. 709 luminance of linear rgb
+inline float luminance(const Vec3<float> &c) {
+    return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+}
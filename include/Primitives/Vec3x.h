@@ -0,0 +1,161 @@
+#pragma once
+
+#include <experimental/simd>
+#include <cstddef>
+
+#include "Vec3.h"
+
+// Lane-parallel companions of Vec3<float>, stored in SoA form:
+// lane i of Vec3x<N> is the vector {x[i], y[i], z[i]}.
+// Operators mirror Vec3, comparisons and per-lane predicates return masks.
+
+namespace stdx = std::experimental;
+
+template<int N>
+using Floatx = stdx::fixed_size_simd<float, N>;
+
+template<int N>
+using Maskx = stdx::fixed_size_simd_mask<float, N>;
+
+template<int N>
+struct Vec3x {
+    Floatx<N> x, y, z;
+
+    static constexpr int width = N;
+
+    explicit Vec3x() : x(0), y(0), z(0) {}
+    explicit Vec3x(const float &k) : x(k), y(k), z(k) {}
+    explicit Vec3x(const Floatx<N> &k) : x(k), y(k), z(k) {}
+    explicit Vec3x(const Vec3<float> &v) : x(v.x), y(v.y), z(v.z) {} // broadcast
+    Vec3x(const Floatx<N> &x, const Floatx<N> &y, const Floatx<N> &z) : x(x), y(y), z(z) {}
+
+    // gather from AoS storage
+    static Vec3x<N> load(const Vec3<float> *v) {
+        return {
+            Floatx<N>([v] (auto i) { return v[i].x; }),
+            Floatx<N>([v] (auto i) { return v[i].y; }),
+            Floatx<N>([v] (auto i) { return v[i].z; })
+        };
+    }
+
+    // scatter to AoS storage
+    void store(Vec3<float> *v) const {
+        for (int i = 0; i < N; ++i) {
+            v[i] = get(i);
+        }
+    }
+
+    Vec3<float> get(int i) const {
+        return {x[i], y[i], z[i]};
+    }
+
+    void set(int i, const Vec3<float> &v) {
+        x[i] = v.x;
+        y[i] = v.y;
+        z[i] = v.z;
+    }
+
+    Maskx<N> operator==(const Vec3x<N> &oth) const {
+        return stdx::abs(x - oth.x) < EPS && stdx::abs(y - oth.y) < EPS && stdx::abs(z - oth.z) < EPS;
+    }
+    Maskx<N> operator!=(const Vec3x<N> &oth) const {
+        return stdx::abs(x - oth.x) > EPS || stdx::abs(y - oth.y) > EPS || stdx::abs(z - oth.z) > EPS;
+    }
+    Vec3x<N> operator*(const Floatx<N> &k) const {
+        return {x * k, y * k, z * k};
+    }
+    Vec3x<N> operator/(const Floatx<N> &k) const {
+        return {x / k, y / k, z / k};
+    }
+    Vec3x<N> operator+(const Floatx<N> &k) const {
+        return {x + k, y + k, z + k};
+    }
+    Vec3x<N> operator*(const Vec3x<N> &k) const {
+        return {x * k.x, y * k.y, z * k.z};
+    }
+    Vec3x<N> operator/(const Vec3x<N> &k) const {
+        return {x / k.x, y / k.y, z / k.z};
+    }
+    Floatx<N> operator%(const Vec3x<N> &oth) const { // dot-product
+        return x * oth.x + y * oth.y + z * oth.z;
+    }
+    Vec3x<N> operator^(const Vec3x<N> &oth) const { // cross-product
+        return {y * oth.z - z * oth.y, z * oth.x - x * oth.z, x * oth.y - y * oth.x};
+    }
+    Vec3x<N> operator+(const Vec3x<N> &oth) const {
+        return {x + oth.x, y + oth.y, z + oth.z};
+    }
+    Vec3x<N> operator-(const Vec3x<N> &oth) const {
+        return {x - oth.x, y - oth.y, z - oth.z};
+    }
+    Vec3x<N> operator-() const {
+        return {-x, -y, -z};
+    }
+    Floatx<N> len() const {
+        return stdx::sqrt(x * x + y * y + z * z);
+    }
+    Vec3x<N> norm() const {
+        return (*this) * (1.f / len());
+    }
+
+    Floatx<N> min() const {
+        return stdx::min(x, stdx::min(y, z));
+    }
+
+    Floatx<N> max() const {
+        return stdx::max(x, stdx::max(y, z));
+    }
+
+    Vec3x<N> clamp(const Vec3x<N> &Min, const Vec3x<N> &Max) const {
+        return { stdx::clamp(x, Min.x, Max.x), stdx::clamp(y, Min.y, Max.y), stdx::clamp(z, Min.z, Max.z) };
+    }
+};
+
+using Vec3x4 = Vec3x<4>;
+using Vec3x8 = Vec3x<8>;
+
+using Floatx4 = Floatx<4>;
+using Floatx8 = Floatx<8>;
+
+using Maskx4 = Maskx<4>;
+using Maskx8 = Maskx<8>;
+
+template<int N>
+Vec3x<N> min(const Vec3x<N> &a, const Vec3x<N> &b) {
+    return { stdx::min(a.x, b.x), stdx::min(a.y, b.y), stdx::min(a.z, b.z) };
+}
+template<int N>
+Vec3x<N> max(const Vec3x<N> &a, const Vec3x<N> &b) {
+    return { stdx::max(a.x, b.x), stdx::max(a.y, b.y), stdx::max(a.z, b.z) };
+}
+
+// per-lane a if mask set, b otherwise
+template<int N>
+Vec3x<N> select(const Maskx<N> &mask, const Vec3x<N> &a, const Vec3x<N> &b) {
+    Vec3x<N> res = b;
+    stdx::where(mask, res.x) = a.x;
+    stdx::where(mask, res.y) = a.y;
+    stdx::where(mask, res.z) = a.z;
+    return res;
+}
+
+template<int N>
+Floatx<N> select(const Maskx<N> &mask, const Floatx<N> &a, const Floatx<N> &b) {
+    Floatx<N> res = b;
+    stdx::where(mask, res) = a;
+    return res;
+}
+
+template<int N>
+Vec3x<N> pow(const Vec3x<N> &v, float p) {
+    return { stdx::pow(v.x, Floatx<N>(p)), stdx::pow(v.y, Floatx<N>(p)), stdx::pow(v.z, Floatx<N>(p)) };
+}
+
+template<int N>
+std::ostream& operator<<(std::ostream &os, const Vec3x<N> &el) {
+    os << '[';
+    for (int i = 0; i < N; ++i) {
+        os << (i ? " " : "") << el.get(i);
+    }
+    return os << ']';
+}
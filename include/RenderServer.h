@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <mutex>
+
+#include "Scene.h"
+#include "Camera.h"
+
+// Long running renderer: scene is parsed and BVH built once, then every
+// request renders it with own camera and setup. Request is one line of json:
+//   {"output": "a.ppm", "width": 320, "height": 240, "spp": 64,
+//    "camera": {"position": [0, 1, 5], "target": [0, 1, 0], "up": [0, 1, 0], "yfov": 0.7},
+//    "depth": 6, "seed": 0, "sampler": "sobol", "adaptive": 0.05, "time": 2, "guiding": true}
+// all fields but output, width, height and spp are optional, camera of scene
+// file and default setup are used for missing ones. Reply is one line of json
+// with stats of render or error. Requests run back to back, every render
+// already uses all threads; socket clients are served concurrently and their
+// requests wait for the render in progress.
+class RenderServer {
+public:
+    explicit RenderServer(Scene &scene);
+
+    // reply to request line
+    std::string handle(const std::string &request);
+
+    // requests from in until end of stream
+    void serve(std::istream &in, std::ostream &out);
+
+    // requests from clients of unix socket at path, thread per connection, never returns
+    void serve_socket(const std::string &path);
+
+private:
+    // request lines of connected socket until client closes it
+    void serve_client(int client);
+
+    Scene &scene;
+    std::mutex render_mutex;
+    Setup base_setup;
+    Camera base_camera;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+#include "third-party/json.hpp"
+
+// Plain counters gathered by renderer locally, e.g. over one tile
+struct RayCounts {
+    uint64_t samples = 0;
+    uint64_t camera_rays = 0;
+    uint64_t bounce_rays = 0;
+    uint64_t shadow_rays = 0;
+
+    uint64_t rays() const {
+        return camera_rays + bounce_rays + shadow_rays;
+    }
+};
+
+// Progress of render. Every thread adds its local counts to own cache line,
+// lines are summed only for reports, so counting never contends.
+struct RenderStats {
+    // reset counters and clock, target is for progress and ETA, 0 if unknown
+    void start(uint64_t samples_target, float time_budget = 0);
+
+    // stop the clock, elapsed time is frozen until next start
+    void finish();
+
+    // add counts of calling thread
+    void add(const RayCounts &counts);
+
+    RayCounts total() const;
+    double elapsed() const;
+
+    // progress line with rates and ETA, at most once per interval of seconds,
+    // may be called from any thread
+    void report(double interval = 1);
+
+    nlohmann::json to_json() const;
+
+private:
+    struct alignas(64) ThreadCounters {
+        std::atomic<uint64_t> samples = 0, camera_rays = 0, bounce_rays = 0, shadow_rays = 0;
+    };
+    std::vector<ThreadCounters> threads;
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    double finished = -1;
+    uint64_t samples_target = 0;
+    float time_budget = 0;
+
+    std::mutex report_lock;
+    double last_report = 0;
+};
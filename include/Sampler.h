@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+#include "Primitives/Vec3.h"
+#include "Primitives/Vec3x.h"
+#include "CounterRng.h"
+
+enum class SampleSequence : uint8_t {
+    Independent, // hashed random numbers
+    Sobol,       // Owen scrambled Sobol, scrambled independently per pixel
+    BlueNoise,   // Sobol shared by all pixels, rotated per pixel by blue noise mask
+};
+
+// independent, sobol or bluenoise
+inline SampleSequence sequence_by_name(const std::string &name) {
+    if (name == "independent") return SampleSequence::Independent;
+    if (name == "sobol") return SampleSequence::Sobol;
+    if (name == "bluenoise") return SampleSequence::BlueNoise;
+    throw std::logic_error("unknown sampler " + name);
+}
+
+// Kinds of random decisions made on every bounce
+enum class SampleSlot : uint32_t {
+    Camera,
+    Bsdf,
+    Light,
+    Roulette,
+};
+
+// Random source of a single path sample. Passed explicitly through camera,
+// materials and distributions, never shared between threads.
+// Each call consumes next dimension of the sample, so it is cheap to create per sample.
+// Dimensions are laid out by (bounce, slot), so every decision is a function of
+// pixel, sample index and bounce only, no matter which thread or renderer runs it.
+class Sampler {
+private:
+    uint32_t pixel_seed; // shared by all pixels for blue noise sequence
+    CounterRng rng; // keyed by (pixel, sample), counter is current dimension
+    uint32_t sample;
+    uint16_t x, y;
+    SampleSequence sequence;
+
+public:
+    Sampler() : pixel_seed(0), rng(), sample(0), x(0), y(0), sequence(SampleSequence::Independent) {}
+    Sampler(SampleSequence sequence, uint16_t x, uint16_t y, uint32_t sample, uint32_t seed = 0)
+        : pixel_seed(sequence == SampleSequence::BlueNoise ? pcg_hash(seed) : pcg_hash((x | uint32_t(y) << 16) ^ pcg_hash(seed))),
+          rng(pixel_seed, sample), sample(sample), x(x), y(y), sequence(sequence) {}
+
+    // jump to dimensions reserved for given decision, each slot has 256 of them
+    void start(uint32_t bounce, SampleSlot slot) {
+        rng.counter = (bounce * 8 + uint32_t(slot)) << 8;
+    }
+
+    // uniform in [0, 1)
+    float next() {
+        if (sequence == SampleSequence::Independent) {
+            return rng.next_float();
+        }
+        return next_ld();
+    }
+
+    // next two dimensions, stratified together by low-discrepancy sequences
+    std::pair<float, float> uniform_2d() {
+        if (sequence != SampleSequence::Independent && rng.counter % 2) {
+            rng.counter++;
+        }
+        float u = next();
+        return {u, next()};
+    }
+
+    float uniform(float Min, float Max) {
+        return Min + (Max - Min) * next();
+    }
+
+    template<int N>
+    Floatx<N> uniform_batch(float Min, float Max) {
+        if (sequence == SampleSequence::Independent) {
+            return Min + (Max - Min) * rng.next_floats<N>();
+        }
+        return Min + (Max - Min) * Floatx<N>([this] (auto) { return next_ld(); });
+    }
+
+    bool bernoulli(float success_rate = 0.5) {
+        return next() < success_rate;
+    }
+
+    int uniform_int(int Min, int Max) {
+        return std::min(Max - 1, Min + int(next() * (Max - Min)));
+    }
+
+private:
+    float next_ld();
+};
@@ -9,6 +9,11 @@
 #include "Object.h"
 #include "Primitives.h"
 #include "BVH.h"
+#include "Sampler.h"
+#include "PathGuiding.h"
+#include "Framebuffer.h"
+#include "RenderStats.h"
+#include "TileWriter.h"
 
 namespace BVH_bounds {
 using T = Object;
@@ -52,6 +57,13 @@ using BVH = RawBVH::BVH<T, F, Map, Merge, Geom, EarlyOut>;
 
 }; // namespace BVH_bounds
 
+// Shadow ray to sampled light point
+struct LightConnection {
+    Ray shadow;
+    float t_max;
+    Vec3<float> radiance; // contribution if shadow ray is not occluded
+};
+
 struct Scene {
     Setup setup;
     Camera camera;
@@ -59,23 +71,52 @@ struct Scene {
     BVH_bounds::BVH bvh;
     std::vector<Object> objs;
 
-    std::unique_ptr<MixedDistribution> light_pdf;
+    std::unique_ptr<LightsDistribution> light_pdf;
+    CosineDistribution bsdf_pdf;
+    // learned guiding, trained in first passes of render_scene if setup.guiding is set
+    std::unique_ptr<GuidingField> guiding;
+    std::unique_ptr<GuidedDistribution> guided_pdf;
+    // directions of diffuse bounces are drawn from it, bsdf_pdf or guided_pdf
+    const Distribution *scatter_pdf = &bsdf_pdf;
+
+    // counters and timing of last render
+    RenderStats stats;
 
     Scene(SceneBuilder&& builder);
 
-    std::vector<std::vector<Vec3<float>>> render_scene();
+    // linear radiance, see Tonemap.h for display. Tiles are pushed to output
+    // after every pass that changed them
+    Framebuffer render_scene(TileWriter *output = nullptr);
 
-private:
-    // x, y in [-1, 1]
-    Vec3<float> postprocess(Vec3<float> in_color);
+    // fixed spp renders of scene from every view, tiles of all views share
+    // one queue, so threads do not wait for the last tile of every image
+    std::vector<Framebuffer> render_batch(const std::vector<Camera> &views);
+
+    // path tracing building blocks, shared by depth-first and wavefront integrators
 
-    Vec3<float> aces_tonemap(const Vec3<float> &x);
+    Sampler make_sampler(uint16_t x, uint16_t y, uint32_t sample) const;
 
-    Vec3<float> gamma_correction(const Vec3<float> &x);
+    // jittered primary ray through pixel (x, y)
+    Ray camera_ray(uint16_t x, uint16_t y, Sampler &sampler);
+    Ray camera_ray(const Camera &view, uint16_t x, uint16_t y, Sampler &sampler) const;
 
-    Vec3<float> saturate(const Vec3<float> &color);
+    // MIS weight of emission found by bsdf sampling with pdf last_pdf,
+    // light_id of hit object avoids second traversal to find the light
+    float emission_weight(float last_pdf, const Ray &ray, const Intersection &i, int32_t light_id);
 
-    Vec3<float> raycast(const Ray& ray, int ttl);
+    // next event estimation: sample light point and build shadow ray to it
+    std::optional<LightConnection> connect_light(const Ray &w_in, const Intersection &i, const Material &material, Sampler &sampler);
+
+    // russian roulette after vertex depth, false if path is terminated
+    bool roulette(Vec3<float> &throughput, int depth, Sampler &sampler);
 
     std::optional<std::pair<Object, Intersection>> get_intersect(const Ray& ray);
+
+    bool occluded(const Ray& ray, float t_max);
+
+private:
+    // iterative path tracing, at most setup.ray_depth bounces
+    // counts traced rays, non-delta vertices are written to records if given
+    Vec3<float> raycast(Ray ray, Sampler &sampler, RayCounts &counts, std::vector<GuideRecord> *records = nullptr);
+
 };
@@ -3,6 +3,8 @@
 #include "Primitives.h"
 #include "Camera.h"
 #include "Object.h"
+#include "Sampler.h"
+#include "Parallel.h"
 #include "third-party/json.hpp"
 
 #include <iostream>
@@ -10,6 +12,10 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <cstring>
 
 using json = nlohmann::json;
 
@@ -19,12 +25,36 @@ struct Setup {
     Vec3<float> bg_color;
     Vec3<float> ambient_light;
     std::pair<uint16_t, uint16_t> dimensions;
+    // paths longer than rr_depth are terminated by russian roulette
+    int rr_depth = 3;
+    SampleSequence sequence = SampleSequence::Sobol;
+    // image is a function of scene, setup and seed only
+    uint32_t seed = 0;
+    // relative error at which pixel stops taking samples, 0 for fixed spp
+    float adaptive_threshold = 0;
+    // progressive mode: render passes of pass_samples spp until time budget
+    // (seconds) runs out or mean pixel error reaches target, samples caps spp
+    float time_budget = 0;
+    float target_error = 0;
+    uint16_t pass_samples = 4;
+    // learn incident radiance in first passes and guide diffuse bounces by it
+    bool guiding = false;
+    // accumulation is saved to checkpoint_path every checkpoint_interval
+    // seconds and at the end, resume continues from it to requested spp
+    std::string checkpoint_path = {};
+    float checkpoint_interval = 300;
+    bool resume = false;
+    // sample index of first sample taken in each pixel, worker processes of
+    // one render take disjoint ranges and their frames are merged
+    uint32_t first_sample = 0;
 };
 
 class SceneBuilder {
 public:
     Setup setup;
     Camera camera;
+    // every camera of scene file in order, camera is the last of them
+    std::vector<Camera> cameras;
     std::vector<Object> objs;
 };
 
@@ -37,13 +67,15 @@ public:
 
         json data = json::parse(fin);
 
-        std::vector<std::ifstream> buffers;
+        // buffers are read once, mesh tasks share the bytes read-only
+        std::vector<std::vector<char>> buffers;
         for (const auto &i : data["buffers"]) {
             std::filesystem::path filename = base_directory / std::string(i["uri"]);
             if (!std::filesystem::exists(filename)) {
                 throw std::logic_error("buffer filename doesn't exists");
             }
-            buffers.emplace_back(filename, std::ios_base::binary);
+            std::ifstream in(filename, std::ios_base::binary);
+            buffers.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
         }
 
         std::vector<std::shared_ptr<Material>> materials;
@@ -72,6 +104,7 @@ public:
             materials.back()->color = color.v;
         }
 
+        std::vector<const json*> mesh_nodes;
         for (const auto &i : data["nodes"]) {
             if (i.contains("camera")) {
                 int camera_id = i["camera"];
@@ -83,88 +116,123 @@ public:
                 auto &perspective = data["cameras"][camera_id]["perspective"];
                 camera.fov_y = perspective["yfov"];
                 camera.calc_fov_x(setup.dimensions.first, setup.dimensions.second);
+                cameras.push_back(camera);
             } else if (i.contains("mesh")) {
-                size_t mesh_id = i["mesh"];
-                Vec3<float> scale = read_vec(i, "scale", Vec3<float>(1));
-                Vec3<float> translation = read_vec(i, "translation", Vec3<float>(0));
-                Quaternion rotation = read_quat(i, "rotation", Quaternion{});
-                const auto& primitives = data["meshes"][mesh_id]["primitives"];
-                for (const auto &primitive : primitives) {
-                    // Now parser support only default primitive mode: TRIANGLES,
-                    // so we should ensure it
-                    if (primitive.contains("mode") && primitive["mode"] != 4) {
-                        throw std::logic_error("Unsupported mode for GLTF primitive");
-                    }
-                    size_t positions_acc_id = primitive["attributes"]["POSITION"];
-                    auto position_acc = data["accessors"][positions_acc_id];
-                    // We work only with triangles so we can calculate normals by vertexes
-                    auto position_buff = data["bufferViews"][static_cast<size_t>(position_acc["bufferView"])];
-                    // TODO: check buffer types
-
-                    std::vector<Vec3<float>> v_positions;
-                    {
-                        std::ifstream &fin = buffers[position_buff["buffer"]];
-                        size_t offset = position_buff["byteOffset"];
-                        size_t len = position_buff["byteLength"];
-                        fin.seekg(offset, std::ios_base::beg);
-                        for (int _ = 0; _ < len; _ += 3 * sizeof(float)) {
-                            float x, y, z;
-                            fin.read(reinterpret_cast<char*>(&x), sizeof(x));
-                            fin.read(reinterpret_cast<char*>(&y), sizeof(y));
-                            fin.read(reinterpret_cast<char*>(&z), sizeof(z));
-                            Vec3<float> vec = {x, y, z};
-                            if (i.contains("matrix")) {
-                                Quaternion x, y, z, w;
-                                int j = 0;
-                                for (auto q : {&x, &y, &z, &w}) {
-                                    q->v.x = i["matrix"][j++];
-                                    q->v.y = i["matrix"][j++];
-                                    q->v.z = i["matrix"][j++];
-                                    q->w = i["matrix"][j++];
-                                }
-                                v_positions.push_back((Mat4{x, y, z, w} * Quaternion{vec, 1.f}).v);
-                            } else {
-                                v_positions.emplace_back(translation + rotation * (scale * vec));
-                            }
-                        }
-                    }
+                mesh_nodes.push_back(&i);
+            } else {
+                std::cerr << "Unparsed node";
+            }
+        }
+
+        // every mesh node is a task, objects are concatenated in node order
+        std::vector<std::vector<Object>> mesh_objs(mesh_nodes.size());
+        std::vector<std::exception_ptr> errors(mesh_nodes.size());
+        run_tasks([&] {
+            for (size_t k = 0; k < mesh_nodes.size(); ++k) {
+#pragma omp task shared(data, buffers, materials, mesh_nodes, mesh_objs, errors)
+                try {
+                    mesh_objs[k] = read_mesh(data, *mesh_nodes[k], buffers, materials);
+                } catch (...) {
+                    errors[k] = std::current_exception();
+                }
+            }
+#pragma omp taskwait
+        });
+        for (size_t k = 0; k < mesh_nodes.size(); ++k) {
+            if (errors[k]) {
+                std::rethrow_exception(errors[k]);
+            }
+            objs.insert(objs.end(), mesh_objs[k].begin(), mesh_objs[k].end());
+        }
+    }
+
+    // triangles of mesh node, only reads shared buffers, so nodes load concurrently
+    std::vector<Object> read_mesh(const json &data, const json &node, const std::vector<std::vector<char>> &buffers,
+                                  const std::vector<std::shared_ptr<Material>> &materials) const {
+        std::vector<Object> res;
+        size_t mesh_id = node.at("mesh");
+        Vec3<float> scale = read_vec(node, "scale", Vec3<float>(1));
+        Vec3<float> translation = read_vec(node, "translation", Vec3<float>(0));
+        Quaternion rotation = read_quat(node, "rotation", Quaternion{});
+        const auto& primitives = data.at("meshes")[mesh_id].at("primitives");
+        for (const auto &primitive : primitives) {
+            // Now parser support only default primitive mode: TRIANGLES,
+            // so we should ensure it
+            if (primitive.contains("mode") && primitive.at("mode") != 4) {
+                throw std::logic_error("Unsupported mode for GLTF primitive");
+            }
+            size_t positions_acc_id = primitive.at("attributes").at("POSITION");
+            auto position_acc = data.at("accessors")[positions_acc_id];
+            // We work only with triangles so we can calculate normals by vertexes
+            auto position_buff = data.at("bufferViews")[static_cast<size_t>(position_acc.at("bufferView"))];
+            // TODO: check buffer types
 
-                    auto indices_acc = data["accessors"][static_cast<size_t>(primitive["indices"])];
-                    auto indices_buff = data["bufferViews"][static_cast<size_t>(indices_acc["bufferView"])];
-                    std::vector<size_t> v_indices;
-                    {
-                        std::ifstream &fin = buffers[indices_buff["buffer"]];
-                        size_t offset = indices_buff["byteOffset"];
-                        size_t len = indices_buff["byteLength"];
-                        fin.seekg(offset, std::ios_base::beg);
-                        for (int i = 0; i < len; i += sizeof(uint16_t)) {
-                            uint16_t x;
-                            fin.read(reinterpret_cast<char*>(&x), sizeof(x));
-                            v_indices.emplace_back(x);
+            std::vector<Vec3<float>> v_positions;
+            {
+                const char *in = buffer_view(buffers, position_buff);
+                size_t len = position_buff.at("byteLength");
+                for (size_t i = 0; i + 3 * sizeof(float) <= len; i += 3 * sizeof(float)) {
+                    float xyz[3];
+                    std::memcpy(xyz, in + i, sizeof(xyz));
+                    Vec3<float> vec = {xyz[0], xyz[1], xyz[2]};
+                    if (node.contains("matrix")) {
+                        Quaternion x, y, z, w;
+                        int j = 0;
+                        for (auto q : {&x, &y, &z, &w}) {
+                            q->v.x = node.at("matrix")[j++];
+                            q->v.y = node.at("matrix")[j++];
+                            q->v.z = node.at("matrix")[j++];
+                            q->w = node.at("matrix")[j++];
                         }
+                        v_positions.push_back((Mat4{x, y, z, w} * Quaternion{vec, 1.f}).v);
+                    } else {
+                        v_positions.emplace_back(translation + rotation * (scale * vec));
                     }
+                }
+            }
 
-                    if (v_indices.size() % 3 != 0) {
-                        throw std::logic_error("3 is not divisor of v_indices size");
-                    }
-                    for (int i = 0; i < v_indices.size(); i += 3) {
-                        objs.push_back({
-                            materials[static_cast<size_t>(primitive["material"])],
-                            std::make_shared<Triangle> (Mat3<float>{
-                                v_positions[v_indices[i]],
-                                v_positions[v_indices[i+1]],
-                                v_positions[v_indices[i+2]]
-                            })
-                        });
-                    }
+            auto indices_acc = data.at("accessors")[static_cast<size_t>(primitive.at("indices"))];
+            auto indices_buff = data.at("bufferViews")[static_cast<size_t>(indices_acc.at("bufferView"))];
+            std::vector<size_t> v_indices;
+            {
+                const char *in = buffer_view(buffers, indices_buff);
+                size_t len = indices_buff.at("byteLength");
+                for (size_t i = 0; i + sizeof(uint16_t) <= len; i += sizeof(uint16_t)) {
+                    uint16_t x;
+                    std::memcpy(&x, in + i, sizeof(x));
+                    v_indices.emplace_back(x);
                 }
-            } else {
-                std::cerr << "Unparsed node";
+            }
+
+            if (v_indices.size() % 3 != 0) {
+                throw std::logic_error("3 is not divisor of v_indices size");
+            }
+            for (int i = 0; i < v_indices.size(); i += 3) {
+                res.push_back({
+                    materials[static_cast<size_t>(primitive.at("material"))],
+                    std::make_shared<Triangle> (Mat3<float>{
+                        v_positions[v_indices[i]],
+                        v_positions[v_indices[i+1]],
+                        v_positions[v_indices[i+2]]
+                    })
+                });
             }
         }
+        return res;
     }
 
-    Vec3<float> read_vec(const json &j, const std::string &field, const Vec3<float> &def) {
+    // start of buffer view bytes, view must lie inside its buffer
+    const char *buffer_view(const std::vector<std::vector<char>> &buffers, const json &view) const {
+        const std::vector<char> &buffer = buffers.at(view.at("buffer"));
+        size_t offset = view.value("byteOffset", size_t(0));
+        size_t len = view.at("byteLength");
+        if (offset > buffer.size() || len > buffer.size() - offset) {
+            throw std::logic_error("buffer view is out of buffer");
+        }
+        return buffer.data() + offset;
+    }
+
+    Vec3<float> read_vec(const json &j, const std::string &field, const Vec3<float> &def) const {
         if (j.contains(field)) {
             return {j[field][0], j[field][1], j[field][2]};
         } else {
@@ -172,7 +240,7 @@ public:
         }
     }
 
-    Quaternion read_quat(const json &j, const std::string &field, const Quaternion &def) {
+    Quaternion read_quat(const json &j, const std::string &field, const Quaternion &def) const {
         if (j.contains(field)) {
             return {{j[field][0], j[field][1], j[field][2]}, j[field][3]};
         } else {
@@ -180,3 +248,20 @@ public:
         }
     }
 };
+
+// Camera of json view {"position": [..], "target": [..], "up": [..], "yfov": ..},
+// missing fields are kept from camera, orientation changes only with target given
+inline Camera read_camera(const json &view, Camera camera) {
+    auto read = [&] (const char *field, const Vec3<float> &def) -> Vec3<float> {
+        if (!view.contains(field)) return def;
+        return {view[field].at(0), view[field].at(1), view[field].at(2)};
+    };
+    Vec3<float> position = read("position", camera.position);
+    if (view.contains("target")) {
+        camera.look_at(position, read("target", Vec3<float>(0)), read("up", Vec3<float>(0, 1, 0)));
+    } else {
+        camera.position = position;
+    }
+    camera.fov_y = view.value("yfov", camera.fov_y);
+    return camera;
+}
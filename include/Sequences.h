@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "CounterRng.h"
+
+// Low-discrepancy sample sequences
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// First two dimensions of Sobol sequence, as 0.32 fixed point
+inline uint32_t sobol(uint32_t index, int dim) {
+    if (dim == 0) {
+        return reverse_bits(index);
+    }
+    uint32_t res = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1) res ^= v;
+    }
+    return res;
+}
+
+// Owen scrambling via hash, "Practical Hash-based Owen Scrambling", Burley 2020
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverse_bits(x);
+}
+
+inline float fixed_to_float(uint32_t x) {
+    return (x >> 8) * 0x1p-24f;
+}
+
+// Coordinate `coord` of Owen scrambled 2D Sobol point, padded to higher
+// dimensions by independent shuffle of sample index per pair of dimensions
+inline float sobol_owen(uint32_t index, uint32_t pair, int coord, uint32_t seed) {
+    uint32_t pair_seed = pcg_hash(seed + pcg_hash(pair));
+    uint32_t shuffled = nested_uniform_scramble(index, pair_seed);
+    return fixed_to_float(nested_uniform_scramble(sobol(shuffled, coord), pcg_hash(pair_seed + coord)));
+}
+
+// Value of tileable blue noise mask in [0, 1), generated once by void-and-cluster
+float blue_noise(uint32_t x, uint32_t y);
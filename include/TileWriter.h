@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Framebuffer.h"
+#include "Tiles.h"
+
+// P6 image written tile by tile while render goes on. File of final size is
+// created black up front, background thread tonemaps queued tiles and writes
+// their rows in place, so the file is a valid image at any moment and whole
+// image is never quantized in memory. Tile pushed again replaces old pixels,
+// also in queue: at most one pending copy of every tile is kept.
+class TileWriter {
+public:
+    TileWriter(const std::string &path, uint16_t width, uint16_t height);
+    ~TileWriter();
+
+    // queue current pixel means of tile, view is not used after return
+    void push(const TileView &view);
+
+    // write queued tiles and close file, throws logic_error if any write failed
+    void finish();
+
+private:
+    struct Job {
+        Tile tile;
+        std::vector<Vec3<float>> mean;
+    };
+
+    std::string path;
+    int fd = -1;
+    size_t header = 0;
+    uint16_t width, height;
+    bool failed = false;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::map<std::pair<uint16_t, uint16_t>, Job> jobs; // by (y0, x0) of tile
+    bool closing = false;
+    std::thread worker;
+
+    void run();
+};
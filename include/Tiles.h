@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Rectangle of pixels [x0, x1) x [y0, y1)
+struct Tile {
+    uint16_t x0, y0, x1, y1;
+
+    uint32_t width() const { return x1 - x0; }
+    uint32_t height() const { return y1 - y0; }
+    uint32_t area() const { return width() * height(); }
+};
+
+// Image split into size x size tiles in Morton order, so consecutive
+// tiles are close on screen and share geometry in caches
+std::vector<Tile> make_tiles(uint16_t width, uint16_t height, uint16_t size = 16);
+
+// Work-stealing queue of tile indices. Every thread owns a contiguous range
+// of tiles and takes them from the front, an idle thread steals from the
+// back of the fullest range.
+struct TileQueue {
+    TileQueue(size_t tiles, int threads);
+
+    // first tile of range owned by thread, range ends where next one begins
+    static size_t range_begin(size_t tiles, int threads, int thread) {
+        return tiles * thread / std::max(threads, 1);
+    }
+
+    // next tile for thread, false when no tiles are left
+    bool pop(int thread, size_t &tile);
+
+private:
+    struct alignas(64) Range {
+        std::mutex lock; // taken to move bounds, reads may go without it
+        std::atomic_size_t begin = 0, end = 0;
+    };
+    std::vector<Range> ranges;
+
+    bool steal(int thread, size_t &tile);
+};
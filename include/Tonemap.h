@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Primitives/Vec3.h"
+#include "Framebuffer.h"
+#include "Image.h"
+
+// Display transform of linear radiance: ACES filmic curve, gamma 2.2, clamp to [0, 1]
+Vec3<float> tonemap(const Vec3<float> &linear);
+
+// Tonemapped and quantized pixel means of framebuffer
+Image tonemap(const Framebuffer &frame);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+
+#include "Primitives/Vec3.h"
+#include "Primitives/Vec3x.h"
+
+// Closed-form warps of [0, 1)^2 samples, constant cost per call.
+// Every warp has scalar and simd batch (Vec3x<N>) variant.
+
+const float PI = M_PI;
+
+// Shirley-Chiu concentric mapping of square to unit disk
+inline std::pair<float, float> square_to_concentric_disk(float u1, float u2) {
+    float a = 2 * u1 - 1, b = 2 * u2 - 1;
+    if (a == 0 && b == 0) {
+        return {0, 0};
+    }
+    float r, phi;
+    if (fabsf(a) > fabsf(b)) {
+        r = a;
+        phi = (PI / 4) * (b / a);
+    } else {
+        r = b;
+        phi = PI / 2 - (PI / 4) * (a / b);
+    }
+    return {r * cosf(phi), r * sinf(phi)};
+}
+
+template<int N>
+std::pair<Floatx<N>, Floatx<N>> square_to_concentric_disk(const Floatx<N> &u1, const Floatx<N> &u2) {
+    Floatx<N> a = 2 * u1 - 1, b = 2 * u2 - 1;
+    Maskx<N> first = stdx::abs(a) > stdx::abs(b);
+    Floatx<N> r = select(first, a, b);
+    Floatx<N> phi = select(first, (PI / 4) * (b / a), PI / 2 - (PI / 4) * (a / b));
+    stdx::where(a == 0 && b == 0, phi) = 0;
+    return {r * stdx::cos(phi), r * stdx::sin(phi)};
+}
+
+// local frame: z is up
+inline Vec3<float> square_to_cosine_hemisphere(float u1, float u2) {
+    auto [x, y] = square_to_concentric_disk(u1, u2);
+    return {x, y, sqrtf(std::max(0.f, 1 - x * x - y * y))};
+}
+
+template<int N>
+Vec3x<N> square_to_cosine_hemisphere(const Floatx<N> &u1, const Floatx<N> &u2) {
+    auto [x, y] = square_to_concentric_disk(u1, u2);
+    return {x, y, stdx::sqrt(stdx::max(Floatx<N>(0), 1 - x * x - y * y))};
+}
+
+inline Vec3<float> square_to_uniform_sphere(float u1, float u2) {
+    float z = 1 - 2 * u1;
+    float r = sqrtf(std::max(0.f, 1 - z * z));
+    float phi = 2 * PI * u2;
+    return {r * cosf(phi), r * sinf(phi), z};
+}
+
+template<int N>
+Vec3x<N> square_to_uniform_sphere(const Floatx<N> &u1, const Floatx<N> &u2) {
+    Floatx<N> z = 1 - 2 * u1;
+    Floatx<N> r = stdx::sqrt(stdx::max(Floatx<N>(0), 1 - z * z));
+    Floatx<N> phi = 2 * PI * u2;
+    return {r * stdx::cos(phi), r * stdx::sin(phi), z};
+}
+
+inline Vec3<float> square_to_uniform_hemisphere(float u1, float u2) {
+    return square_to_uniform_sphere(u1 / 2, u2);
+}
+
+template<int N>
+Vec3x<N> square_to_uniform_hemisphere(const Floatx<N> &u1, const Floatx<N> &u2) {
+    return square_to_uniform_sphere(u1 / 2, u2);
+}
+
+inline float cosine_hemisphere_pdf(float cos_theta) {
+    return std::max(0.f, cos_theta) * float(M_1_PI);
+}
+
+// Orthonormal basis around unit n without branches, Duff et al. 2017
+inline std::pair<Vec3<float>, Vec3<float>> onb(const Vec3<float> &n) {
+    float sign = copysignf(1.f, n.z);
+    float a = -1 / (sign + n.z);
+    float b = n.x * n.y * a;
+    return {
+        {1 + sign * n.x * n.x * a, sign * b, -sign * n.x},
+        {b, sign + n.y * n.y * a, -n.y}
+    };
+}
+
+template<int N>
+std::pair<Vec3x<N>, Vec3x<N>> onb(const Vec3x<N> &n) {
+    Floatx<N> sign = stdx::copysign(Floatx<N>(1), n.z);
+    Floatx<N> a = -1 / (sign + n.z);
+    Floatx<N> b = n.x * n.y * a;
+    return {
+        {1 + sign * n.x * n.x * a, sign * b, -sign * n.x},
+        {b, sign + n.y * n.y * a, -n.y}
+    };
+}
+
+// local direction (z is up) to world frame around unit n
+inline Vec3<float> to_world(const Vec3<float> &local, const Vec3<float> &n) {
+    auto [t, b] = onb(n);
+    return t * local.x + b * local.y + n * local.z;
+}
+
+template<int N>
+Vec3x<N> to_world(const Vec3x<N> &local, const Vec3x<N> &n) {
+    auto [t, b] = onb(n);
+    return t * local.x + b * local.y + n * local.z;
+}
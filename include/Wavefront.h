@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Scene.h"
+#include "Primitives.h"
+#include "Sampler.h"
+#include "Framebuffer.h"
+#include "RenderStats.h"
+
+// Breadth-first path tracer. Keeps a batch of path states in SoA buffers
+// and advances all of them one stage per pass:
+// generate -> extend -> shade -> connect -> compact.
+struct WavefrontRenderer {
+    Scene &scene;
+    size_t batch_size;
+
+    WavefrontRenderer(Scene &scene, size_t batch_size = 1 << 16);
+
+    Framebuffer render();
+
+private:
+    // path states
+    std::vector<Vec3<float>> origin, dir;
+    std::vector<Vec3<float>> throughput, radiance;
+    std::vector<float> last_pdf;
+    std::vector<uint32_t> pixel;
+    std::vector<uint16_t> depth;
+    std::vector<uint8_t> alive;
+    std::vector<Sampler> sampler;
+
+    // extend stage results, material is nullptr on miss
+    std::vector<Material*> material;
+    std::vector<Intersection> hit;
+    std::vector<int32_t> light; // light_id of hit object
+
+    // connect stage queue, indexed by path
+    std::vector<uint8_t> has_shadow;
+    std::vector<LightConnection> shadow;
+
+    // paths sorted by hit material for shading
+    std::vector<std::pair<Material*, uint32_t>> order;
+
+    Framebuffer accum;
+    RayCounts counts; // of current iteration
+    size_t next_sample = 0;
+    size_t samples_total = 0;
+
+    size_t size() const { return origin.size(); }
+    void resize(size_t n);
+    void move_path(size_t to, size_t from);
+
+    void generate();
+    void extend();
+    void shade();
+    void connect();
+    void compact();
+};
@@ -0,0 +1,109 @@
+#include "AdaptiveSampling.h"
+
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+// Pixel error as max over 3x3 window. Own error of pixel is low exactly when
+// its samples missed rare bright paths, stopping on it alone darkens the image.
+static std::vector<float> window_error(const Framebuffer &frame) {
+    const int r = 1;
+    std::vector<float> res(frame.size(), 0);
+    for (int y = 0; y < frame.height; ++y) {
+        for (int x = 0; x < frame.width; ++x) {
+            float e = 0;
+            for (int dy = -r; dy <= r; ++dy) {
+                for (int dx = -r; dx <= r; ++dx) {
+                    int nx = std::clamp(x + dx, 0, frame.width - 1), ny = std::clamp(y + dy, 0, frame.height - 1);
+                    e = std::max(e, frame.at(nx, ny).error());
+                }
+            }
+            res[y * frame.width + x] = e;
+        }
+    }
+    return res;
+}
+
+SampleAllocator::SampleAllocator(const Framebuffer &frame, uint32_t spp, float threshold)
+    : pixels(frame.size()), spp(spp), threshold(threshold), max_per_pixel(8 * spp) {
+    size_t taken = 0;
+    for (size_t i = 0; i < pixels; ++i) {
+        taken += frame[i].count;
+    }
+    remaining = pixels * spp - std::min(taken, pixels * spp);
+}
+
+bool SampleAllocator::next_round(const Framebuffer &stats, std::vector<uint32_t> &alloc) {
+    alloc.assign(pixels, 0);
+    if (remaining == 0) return false;
+
+    if (round++ == 0) {
+        // top every pixel up to initial count
+        uint32_t initial = threshold > 0 ? std::min(spp, std::max(8u, spp / 8)) : spp;
+        size_t spent = 0;
+        for (size_t i = 0; i < pixels; ++i) {
+            alloc[i] = initial - std::min(stats[i].count, initial);
+            spent += alloc[i];
+        }
+        remaining = threshold > 0 ? remaining - std::min(spent, remaining) : 0;
+        return spent > 0 || remaining > 0;
+    }
+
+    std::vector<float> pixel_error = window_error(stats);
+    std::vector<float> error(pixels, 0);
+    double total_error = 0;
+    size_t active = 0;
+    for (size_t i = 0; i < pixels; ++i) {
+        if (stats[i].count >= max_per_pixel) continue;
+        float e = pixel_error[i];
+        if (e < threshold) continue;
+        error[i] = std::min(e, 1e3f);
+        total_error += error[i];
+        active++;
+    }
+    if (active == 0) return false;
+
+    size_t budget = std::max(remaining / 2, std::min(remaining, active));
+    // every pixel gets whole part of its share, samples left by rounding go to
+    // the largest fractional parts, so allocation does not depend on scan order
+    size_t spent = 0;
+    std::vector<std::pair<double, size_t>> fractions;
+    for (size_t i = 0; i < pixels; ++i) {
+        if (error[i] == 0) continue;
+        double share = budget * error[i] / total_error;
+        size_t room = max_per_pixel - stats[i].count;
+        size_t n = std::min(size_t(share), room);
+        alloc[i] = n;
+        spent += n;
+        if (n < room) fractions.emplace_back(share - n, i);
+    }
+    std::sort(fractions.begin(), fractions.end(), [] (const auto &a, const auto &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    for (size_t k = 0; k < fractions.size() && spent < budget; ++k) {
+        alloc[fractions[k].second]++;
+        spent++;
+    }
+    remaining -= std::min(spent, remaining);
+    return spent > 0;
+}
+
+ProgressiveSchedule::ProgressiveSchedule(size_t pixels, uint32_t pass_spp, uint32_t max_spp, float target_error, float threshold)
+    : pixels(pixels), pass_spp(pass_spp), max_spp(max_spp), target_error(target_error), threshold(threshold) {}
+
+bool ProgressiveSchedule::next_round(const Framebuffer &stats, std::vector<uint32_t> &alloc) {
+    alloc.assign(pixels, 0);
+    std::vector<float> pixel_error = window_error(stats);
+    double total_error = 0;
+    size_t spent = 0;
+    for (size_t i = 0; i < pixels; ++i) {
+        float e = std::min(pixel_error[i], 1e3f);
+        total_error += std::min(stats[i].error(), 1e3f);
+        if (stats[i].count >= max_spp || e < threshold) continue;
+        alloc[i] = std::min(pass_spp, max_spp - stats[i].count);
+        spent += alloc[i];
+    }
+    mean_error = total_error / pixels;
+    if (target_error > 0 && mean_error <= target_error) return false;
+    return spent > 0;
+}
@@ -0,0 +1,35 @@
+#include "AliasTable.h"
+
+#include <numeric>
+
+// Vose's construction
+AliasTable::AliasTable(const std::vector<float> &weights) : prob(weights.size()), alias(weights.size()) {
+    size_t n = weights.size();
+    double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    std::vector<double> scaled(n);
+    std::vector<uint32_t> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = total > 0 ? weights[i] * n / total : 1;
+        (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(), l = large.back();
+        small.pop_back();
+        prob[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // leftovers are equal to 1 up to rounding
+    for (uint32_t i : small) {
+        prob[i] = 1;
+        alias[i] = i;
+    }
+    for (uint32_t i : large) {
+        prob[i] = 1;
+        alias[i] = i;
+    }
+}
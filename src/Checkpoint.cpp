@@ -0,0 +1,118 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace {
+
+const char magic[8] = {'K', 'E', 'N', 'G', 'C', 'K', 'P', '3'};
+
+struct Header {
+    char magic[8];
+    uint32_t pixel_size;
+    uint16_t width, height;
+    uint32_t seed;
+    uint32_t sequence;
+    uint32_t first_sample;
+    // estimator settings, samples of different ones must not be mixed
+    int32_t ray_depth, rr_depth;
+    uint32_t guiding;
+};
+
+Header make_header(uint16_t width, uint16_t height, const Setup &setup) {
+    Header h = {};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.pixel_size = sizeof(PixelStats);
+    h.width = width;
+    h.height = height;
+    h.seed = setup.seed;
+    h.sequence = uint32_t(setup.sequence);
+    h.first_sample = setup.first_sample;
+    h.ray_depth = setup.ray_depth;
+    h.rr_depth = setup.rr_depth;
+    h.guiding = setup.guiding;
+    return h;
+}
+
+}
+
+void save_checkpoint(const std::string &path, const Framebuffer &frame, const Setup &setup) {
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) {
+        throw std::logic_error("can not write checkpoint " + tmp);
+    }
+    Header h = make_header(frame.width, frame.height, setup);
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (uint16_t y = 0; y < frame.height && ok; ++y) {
+        ok = fwrite(&frame.at(0, y), sizeof(PixelStats), frame.width, f) == frame.width;
+    }
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        std::filesystem::remove(tmp);
+        throw std::logic_error("failed to write checkpoint " + tmp);
+    }
+    // old checkpoint stays valid until new one is complete
+    std::filesystem::rename(tmp, path);
+    // rename itself is durable only when directory entry is on disk
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || fsync(fd) != 0) {
+        if (fd >= 0) close(fd);
+        throw std::logic_error("failed to sync directory of checkpoint " + path);
+    }
+    close(fd);
+}
+
+static Framebuffer read_frame(FILE *f, const std::string &path, uint16_t width, uint16_t height) {
+    Framebuffer frame(width, height);
+    bool ok = true;
+    for (uint16_t y = 0; y < height && ok; ++y) {
+        ok = fread(&frame.at(0, y), sizeof(PixelStats), width, f) == width;
+    }
+    fclose(f);
+    if (!ok) {
+        throw std::logic_error("checkpoint " + path + " is truncated");
+    }
+    return frame;
+}
+
+Framebuffer load_checkpoint(const std::string &path, const Setup &setup) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        throw std::logic_error("can not read checkpoint " + path);
+    }
+    auto [width, height] = setup.dimensions;
+    Header expected = make_header(width, height, setup);
+    Header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || std::memcmp(&h, &expected, sizeof(h)) != 0) {
+        fclose(f);
+        throw std::logic_error("checkpoint " + path + " does not match resolution, sampler, seed, depth or guiding of render");
+    }
+    return read_frame(f, path, width, height);
+}
+
+Framebuffer load_partial(const std::string &path, Setup &setup) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        throw std::logic_error("can not read checkpoint " + path);
+    }
+    Header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.pixel_size != sizeof(PixelStats)) {
+        fclose(f);
+        throw std::logic_error(path + " is not a checkpoint of this build");
+    }
+    setup.dimensions = {h.width, h.height};
+    setup.seed = h.seed;
+    setup.sequence = SampleSequence(h.sequence);
+    setup.first_sample = h.first_sample;
+    setup.ray_depth = h.ray_depth;
+    setup.rr_depth = h.rr_depth;
+    setup.guiding = h.guiding;
+    return read_frame(f, path, h.width, h.height);
+}
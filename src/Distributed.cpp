@@ -0,0 +1,110 @@
+#include "Distributed.h"
+#include "Checkpoint.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+std::vector<SampleRange> split_samples(uint32_t samples, int parts, uint32_t reserve) {
+    std::vector<SampleRange> ranges;
+    uint32_t first = 0;
+    for (int i = 0; i < parts; ++i) {
+        uint32_t count = samples / parts + (uint32_t(i) < samples % parts);
+        ranges.push_back({first, count});
+        first += reserve * count;
+    }
+    return ranges;
+}
+
+void run_workers(const std::vector<std::vector<std::string>> &args, int threads) {
+    // environment of this process with own OMP_NUM_THREADS
+    std::string omp_threads = "OMP_NUM_THREADS=" + std::to_string(std::max<int>(1, threads / args.size()));
+    std::vector<char*> env;
+    for (char **e = environ; *e; ++e) {
+        if (std::strncmp(*e, "OMP_NUM_THREADS=", 16) != 0) env.push_back(*e);
+    }
+    env.push_back(omp_threads.data());
+    env.push_back(nullptr);
+
+    std::vector<pid_t> pids;
+    for (size_t i = 0; i < args.size(); ++i) {
+        std::vector<char*> argv;
+        for (auto &arg : args[i]) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        pid_t pid;
+        if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, argv.data(), env.data()) != 0) {
+            for (pid_t p : pids) {
+                waitpid(p, nullptr, 0);
+            }
+            throw std::logic_error("can not start worker " + std::to_string(i));
+        }
+        std::cerr << "Worker " << i << " started, pid " << pid << '\n';
+        pids.push_back(pid);
+    }
+
+    std::string failed;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        int status = 0;
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed += ' ' + std::to_string(i);
+        }
+    }
+    if (!failed.empty()) {
+        throw std::logic_error("workers failed:" + failed);
+    }
+}
+
+Framebuffer merge_partials(const std::vector<std::string> &paths) {
+    struct Partial {
+        Setup setup;
+        Framebuffer frame;
+        uint32_t end = 0; // one past last sample index taken by any pixel
+    };
+    if (paths.empty()) {
+        throw std::logic_error("nothing to merge");
+    }
+    std::vector<Partial> parts(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        Partial &p = parts[i];
+        p.frame = load_partial(paths[i], p.setup);
+        uint32_t count = 0;
+        for (size_t k = 0; k < p.frame.size(); ++k) {
+            count = std::max(count, p.frame[k].count);
+        }
+        p.end = p.setup.first_sample + count;
+        const Setup &s = parts[0].setup;
+        if (p.setup.dimensions != s.dimensions || p.setup.seed != s.seed || p.setup.sequence != s.sequence ||
+            p.setup.ray_depth != s.ray_depth || p.setup.rr_depth != s.rr_depth || p.setup.guiding != s.guiding) {
+            throw std::logic_error(paths[i] + " is not a part of same render as " + paths[0]);
+        }
+    }
+
+    std::sort(parts.begin(), parts.end(), [] (const Partial &a, const Partial &b) {
+        return a.setup.first_sample < b.setup.first_sample;
+    });
+    for (size_t i = 1; i < parts.size(); ++i) {
+        if (parts[i].setup.first_sample < parts[i - 1].end) {
+            throw std::logic_error("partial frames repeat samples " + std::to_string(parts[i].setup.first_sample) +
+                                   " to " + std::to_string(parts[i - 1].end - 1));
+        }
+    }
+
+    Framebuffer frame = std::move(parts[0].frame);
+    for (size_t i = 1; i < parts.size(); ++i) {
+        for (uint16_t y = 0; y < frame.height; ++y) {
+            for (uint16_t x = 0; x < frame.width; ++x) {
+                frame.at(x, y).merge(parts[i].frame.at(x, y));
+            }
+        }
+    }
+    return frame;
+}
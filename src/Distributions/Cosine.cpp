@@ -1,5 +1,6 @@
 #include "Primitives/Vec3.h"
-#include "Rnd.h"
+#include "Sampler.h"
+#include "Warp.h"
 
 #include "Distribution.h"
 
@@ -9,11 +10,11 @@ CosineDistribution::CosineDistribution() : Distribution() {}
 
 CosineDistribution::~CosineDistribution() {};
 
-vec3 CosineDistribution::sample(const vec3 &pos, const vec3 &n) const {
-    vec3 res = rnd->in_sphere();
-    return (res + n).norm();
+vec3 CosineDistribution::sample(const vec3 &pos, const vec3 &n, Sampler &sampler) const {
+    auto [u1, u2] = sampler.uniform_2d();
+    return to_world(square_to_cosine_hemisphere(u1, u2), n);
 }
 
 float CosineDistribution::pdf(const vec3 &pos, const vec3 &n, const vec3 &d) const {
-    return std::max(0.0, d % n / M_PI);
+    return cosine_hemisphere_pdf(d % n);
 }
@@ -0,0 +1,32 @@
+#include "Primitives/Vec3.h"
+#include "Sampler.h"
+#include "Warp.h"
+
+#include "PathGuiding.h"
+
+typedef Vec3<float> vec3;
+
+GuidedDistribution::GuidedDistribution(const GuidingField &field, float bsdf_fraction) : Distribution(), field(field), bsdf_fraction(bsdf_fraction) {}
+
+GuidedDistribution::~GuidedDistribution() {};
+
+vec3 GuidedDistribution::sample(const vec3 &pos, const vec3 &n, Sampler &sampler) const {
+    auto [u1, u2] = sampler.uniform_2d();
+    const DTree *tree = field.lookup(pos);
+    if (!tree) {
+        return to_world(square_to_cosine_hemisphere(u1, u2), n);
+    }
+    // one sample picks the lobe and is rescaled to stay stratified
+    if (u1 < bsdf_fraction) {
+        return to_world(square_to_cosine_hemisphere(u1 / bsdf_fraction, u2), n);
+    }
+    return tree->sample((u1 - bsdf_fraction) / (1 - bsdf_fraction), u2);
+}
+
+float GuidedDistribution::pdf(const vec3 &pos, const vec3 &n, const vec3 &d) const {
+    const DTree *tree = field.lookup(pos);
+    if (!tree) {
+        return cosine_hemisphere_pdf(d % n);
+    }
+    return bsdf_fraction * cosine_hemisphere_pdf(d % n) + (1 - bsdf_fraction) * tree->pdf(d);
+}
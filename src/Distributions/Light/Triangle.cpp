@@ -1,27 +1,19 @@
 #include "Primitives/Vec3.h"
-#include "Rnd.h"
+#include "Primitives/Mat3.h"
 
 #include "Distribution.h"
 
 typedef Vec3<float> vec3;
 
-TriangleDistribution::TriangleDistribution(std::shared_ptr<Triangle> geom)
-    : LightDistribution(geom), tr(geom) {};
-
-TriangleDistribution::~TriangleDistribution() {};
-
-vec3 TriangleDistribution::sample_() const {
-    auto rnd = Rnd::getRnd();
-    auto [x, y] = std::make_tuple(rnd->uniform(0, 1), rnd->uniform(0, 1));
-    if (x + y > 1) {
-        x = 1 - x;
-        y = 1 - y;
-    }
-    vec3 bari = vec3 {1 - x - y, x, y};
-    return tr->vert * bari;
-}
-
-float TriangleDistribution::pdf_(const Vec3<float>&) const {
-    float square = 0.5 * (tr->u ^ tr->v).len();
-    return 1 / square;
+EmissiveTriangle::EmissiveTriangle(const Triangle &tr, const vec3 &emission)
+    : emission(emission), select_pdf(0) {
+    auto gvert = Mat3<float>(tr.position) + tr.rotation * tr.vert;
+    v0 = gvert.x;
+    e1 = gvert.y - gvert.x;
+    e2 = gvert.z - gvert.x;
+    vec3 cross = e1 ^ e2;
+    area = 0.5 * cross.len();
+    normal = cross.norm();
+    // emitters are two-sided
+    power = 2 * M_PI * area * luminance(emission);
 }
@@ -0,0 +1,34 @@
+#include "Primitives/Vec3.h"
+#include "Sampler.h"
+
+#include "Distribution.h"
+#include <memory>
+
+typedef Vec3<float> vec3;
+
+LightsDistribution::LightsDistribution(std::vector<EmissiveTriangle> &&lights_) : lights(std::move(lights_)) {
+    std::vector<float> power;
+    float total = 0;
+    for (const auto &light : lights) {
+        power.push_back(light.power);
+        total += light.power;
+    }
+    for (auto &light : lights) {
+        light.select_pdf = total > 0 ? light.power / total : 1.f / lights.size();
+    }
+    alias = AliasTable(power);
+}
+
+std::optional<LightSample> LightsDistribution::sample_light(const vec3 &pos, Sampler &sampler) const {
+    if (lights.empty()) return std::nullopt;
+    const EmissiveTriangle &light = lights[alias.sample(sampler.next())];
+    auto [x, y] = sampler.uniform_2d();
+    if (x + y > 1) {
+        x = 1 - x;
+        y = 1 - y;
+    }
+    vec3 to_light = light.v0 + light.e1 * x + light.e2 * y - pos;
+    float t = to_light.len();
+    vec3 d = to_light / t;
+    return LightSample {d, t, light.emission, light.pdf(d, t)};
+}
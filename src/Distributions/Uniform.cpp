@@ -1,5 +1,6 @@
 #include "Primitives/Vec3.h"
-#include "Rnd.h"
+#include "Sampler.h"
+#include "Warp.h"
 
 #include "Distribution.h"
 
@@ -9,14 +10,11 @@ UniformDistribution::UniformDistribution() : Distribution() {}
 
 UniformDistribution::~UniformDistribution() {};
 
-vec3 UniformDistribution::sample(const vec3 &pos, const vec3 &n) const {
-    vec3 res = rnd->in_sphere();
-    if (res % n < 0) {
-        res = -res;
-    }
-    return res;
+vec3 UniformDistribution::sample(const vec3 &pos, const vec3 &n, Sampler &sampler) const {
+    auto [u1, u2] = sampler.uniform_2d();
+    return to_world(square_to_uniform_hemisphere(u1, u2), n);
 }
 
 float UniformDistribution::pdf(const vec3 &pos, const vec3 &n, const vec3 &d) const {
-    return (d % n > 0 ? 1 / (M_PI * 2) : 0);
+    return (d % n > 0 ? 1 / (2 * PI) : 0);
 }
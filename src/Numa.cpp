@@ -0,0 +1,91 @@
+#include "Numa.h"
+#include "Parallel.h"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <iostream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+// "0-3,8-11" to list of cpus
+static std::vector<int> parse_cpulist(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty() || part == "\n") continue;
+        size_t dash = part.find('-');
+        int first = std::stoi(part.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+        for (int c = first; c <= last; ++c) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+NumaTopology NumaTopology::detect() {
+    NumaTopology topology;
+    const std::filesystem::path root = "/sys/devices/system/node";
+    for (int node = 0; std::filesystem::exists(root / ("node" + std::to_string(node))); ++node) {
+        std::string list;
+        std::getline(std::ifstream(root / ("node" + std::to_string(node)) / "cpulist"), list);
+        std::vector<int> cpus = parse_cpulist(list);
+        // memory only nodes run no threads
+        if (!cpus.empty()) {
+            topology.nodes.push_back({node, std::move(cpus)});
+        }
+    }
+    if (topology.nodes.empty()) {
+        std::vector<int> cpus;
+        for (long c = 0; c < sysconf(_SC_NPROCESSORS_ONLN); ++c) {
+            cpus.push_back(c);
+        }
+        topology.nodes.push_back({0, std::move(cpus)});
+    }
+    return topology;
+}
+
+void pin_threads(const NumaTopology &topology) {
+    if (topology.nodes.size() < 2) return;
+    int threads = max_threads();
+#pragma omp parallel
+    {
+        int node = size_t(thread_num()) * topology.nodes.size() / threads;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : topology.nodes[node].cpus) {
+            CPU_SET(cpu, &set);
+        }
+        // pid 0 is the calling thread
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+#pragma omp critical
+            std::cerr << "Failed to pin thread " << thread_num() << " to node " << node << '\n';
+        }
+    }
+    std::cerr << "Render threads pinned to " << topology.nodes.size() << " NUMA nodes\n";
+}
+
+void interleave_memory(const NumaTopology &topology) {
+    if (topology.nodes.size() < 2) return;
+    unsigned long mask = 0;
+    for (auto &node : topology.nodes) {
+        if (node.id < int(8 * sizeof(mask))) {
+            mask |= 1ul << node.id;
+        }
+    }
+    if (syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, &mask, 8 * sizeof(mask)) != 0) {
+        std::cerr << "Failed to interleave memory over NUMA nodes\n";
+    }
+}
+
+void reset_memory_policy() {
+    // policy is per thread and inherited by threads created under it, the
+    // OpenMP pool was started while interleaving and needs reset on every thread
+#pragma omp parallel
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+}
@@ -1,39 +1,41 @@
 #include <memory>
 #include <optional>
-#include <functional>
 #include <stdexcept>
 #include <algorithm>
 #include <math.h>
 #include <iostream>
 #include <cmath>
 
-#include "Rnd.h"
+#include "Sampler.h"
 #include "Primitives.h"
 #include "Distribution.h"
 
 #include "Object/Material.h"
 
-Vec3<float> Diffuse::sample(Ray w_in, Intersection i, const Distribution& dist,
-                            const std::function<Vec3<float>(const Ray&)> &raycast) {
+Scatter Diffuse::sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler) {
     Vec3<float> pos = w_in.reveal(i.t);
     {
         Ray r = {pos, i.normal};
         r.bump();
         pos = r.start;
     }
-    Vec3<float> w_out = dist.sample(pos, i.normal);
+    Vec3<float> w_out = dist.sample(pos, i.normal, sampler);
     Ray r_out = Ray {pos, w_out};
 
     r_out.bump();
     if (emission.len() > 1e-5) {
-        return emission;
+        return {emission, Vec3<float>(0), std::nullopt};
     }
+    auto tmp = dist.pdf(pos, i.normal, w_out);
     if (w_out % i.normal <= 1e-6) {
-        return {0, 0, 0};
+        return {Vec3<float>(0), Vec3<float>(0), std::nullopt, tmp};
     }
 
-    auto tmp = dist.pdf(pos, i.normal, w_out);
-    return emission + (color / M_PI) * raycast(r_out) * (i.normal % w_out) / tmp;
+    return {emission, (color / M_PI) * (i.normal % w_out) / tmp, r_out, tmp};
+}
+
+Vec3<float> Diffuse::eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const {
+    return (color / M_PI) * std::max(0.f, i.normal % w_out);
 }
 
 static Ray reflect(const Vec3<float> pos, const Vec3<float> d, const Vec3<float> normal) {
@@ -42,14 +44,16 @@ static Ray reflect(const Vec3<float> pos, const Vec3<float> d, const Vec3<float>
     return reflected;
 };
 
-Vec3<float> Metallic::sample(Ray w_in, Intersection i, const Distribution& dist,
-                        const std::function<Vec3<float>(const Ray&)> &raycast) {
+Scatter Metallic::sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler) {
     Vec3<float> pos = w_in.reveal(i.t);
-    return emission + color * raycast(reflect(pos, w_in.v, i.normal));
+    return {emission, color, reflect(pos, w_in.v, i.normal)};
 }
 
-Vec3<float> Dielectric::sample(Ray w_in, Intersection i, const Distribution& dist,
-                        const std::function<Vec3<float>(const Ray&)> &raycast) {
+Vec3<float> Metallic::eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const {
+    return Vec3<float>(0);
+}
+
+Scatter Dielectric::sample(const Ray &w_in, const Intersection &i, const Distribution& dist, Sampler &sampler) {
     float k = (i.is_inside ? ior : 1 / ior);
 
     Vec3<float> pos = w_in.reveal(i.t);
@@ -60,26 +64,30 @@ Vec3<float> Dielectric::sample(Ray w_in, Intersection i, const Distribution& dis
         // zero refract case
         Ray reflected = reflect(pos, w_in.v, i.normal);
         reflected.bump();
-        return raycast(reflected);
+        return {Vec3<float>(0), Vec3<float>(1), reflected};
     } else {
         float cos_phi2 = sqrt(1 - sin_phi2 * sin_phi2);
-        float rnd_val = Rnd::getRnd()->uniform(0, 1);
+        float rnd_val = sampler.uniform(0, 1);
 
         if (rnd_val > get_reflectness(cos_phi1)) {
             // refraction case
             Ray refracted = {pos, (w_in.v * k + i.normal * (k * cos_phi1 - cos_phi2)).norm()};
             refracted.bump();
-            return (!i.is_inside ? color : Vec3<float>{1}) * raycast(refracted);
+            return {Vec3<float>(0), (!i.is_inside ? color : Vec3<float>{1}), refracted};
         } else {
             // reflection case
             Ray reflected = reflect(pos, w_in.v, i.normal);
             reflected.bump();
-            return raycast(reflected);
+            return {Vec3<float>(0), Vec3<float>(1), reflected};
         }
     }
 
 }
 
+Vec3<float> Dielectric::eval(const Ray &w_in, const Intersection &i, const Vec3<float> &w_out) const {
+    return Vec3<float>(0);
+}
+
 float pow5(float x) {
     float tmp = x * x;
     return tmp * tmp * x;
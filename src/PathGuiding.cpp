@@ -0,0 +1,194 @@
+#include "PathGuiding.h"
+#include "Warp.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+const float spatial_threshold = 12000;
+const float energy_threshold = 0.01;
+const int max_dtree_depth = 20;
+
+// just below 1, keeps rescaled samples inside quadrant
+const float one_minus_eps = 0x1.fffffep-1f;
+
+std::pair<float, float> dir_to_square(const Vec3<float> &d) {
+    float u = std::clamp((d.z + 1) / 2, 0.f, one_minus_eps);
+    float v = atan2f(d.y, d.x) / (2 * PI);
+    if (v < 0) v += 1;
+    return {u, std::min(v, one_minus_eps)};
+}
+
+Vec3<float> square_to_dir(float u, float v) {
+    float cos_theta = 2 * u - 1;
+    float sin_theta = sqrtf(std::max(0.f, 1 - cos_theta * cos_theta));
+    float phi = 2 * PI * v;
+    return {sin_theta * cosf(phi), sin_theta * sinf(phi), cos_theta};
+}
+
+// pick quadrant of point (u, v) and rescale point to it
+int descend(float &u, float &v) {
+    int qx = u >= 0.5f, qy = v >= 0.5f;
+    u = std::min(u * 2 - qx, one_minus_eps);
+    v = std::min(v * 2 - qy, one_minus_eps);
+    return qx + 2 * qy;
+}
+
+float &coord(Vec3<float> &p, int axis) {
+    return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+}
+
+void DTree::record(const Vec3<float> &d, float value) {
+    auto [u, v] = dir_to_square(d);
+    samples++;
+    uint32_t node = 0;
+    while (true) {
+        int q = descend(u, v);
+        nodes[node].sum[q] += value;
+        if (!nodes[node].child[q]) return;
+        node = nodes[node].child[q];
+    }
+}
+
+float DTree::pdf(const Vec3<float> &d) const {
+    auto [u, v] = dir_to_square(d);
+    float res = 1 / (4 * PI);
+    uint32_t node = 0;
+    while (true) {
+        auto &s = nodes[node].sum;
+        float all = s[0] + s[1] + s[2] + s[3];
+        if (all <= 0) return 0;
+        int q = descend(u, v);
+        res *= 4 * s[q] / all;
+        if (!nodes[node].child[q]) return res;
+        node = nodes[node].child[q];
+    }
+}
+
+Vec3<float> DTree::sample(float u1, float u2) const {
+    float u = 0, v = 0, size = 1;
+    uint32_t node = 0;
+    while (true) {
+        auto &s = nodes[node].sum;
+        // column by marginal mass, then row inside it
+        float left = s[0] + s[2], all = left + s[1] + s[3];
+        int qx = u1 * all >= left && all > left;
+        u1 = qx ? (u1 * all - left) / (all - left) : u1 * all / left;
+        float bottom = s[qx], column = bottom + s[qx + 2];
+        int qy = u2 * column >= bottom && column > bottom;
+        u2 = qy ? (u2 * column - bottom) / (column - bottom) : u2 * column / bottom;
+        u1 = std::clamp(u1, 0.f, one_minus_eps);
+        u2 = std::clamp(u2, 0.f, one_minus_eps);
+
+        int q = qx + 2 * qy;
+        size /= 2;
+        u += qx * size;
+        v += qy * size;
+        if (!nodes[node].child[q]) {
+            return square_to_dir(u + u1 * size, v + u2 * size);
+        }
+        node = nodes[node].child[q];
+    }
+}
+
+DTree DTree::refined(float threshold, int max_depth) const {
+    DTree res;
+    float limit = total() * threshold;
+    if (limit <= 0) return res;
+
+    struct Item {
+        uint32_t dst;
+        int64_t src; // node of this tree or -1 if it has no such node
+        std::array<float, 4> sum;
+        int depth;
+    };
+    std::vector<Item> stack = {{0, 0, nodes[0].sum, 1}};
+    while (!stack.empty()) {
+        Item it = stack.back();
+        stack.pop_back();
+        for (int q = 0; q < 4; ++q) {
+            if (it.depth >= max_depth || it.sum[q] <= limit) continue;
+            uint32_t child = res.nodes.size();
+            res.nodes.emplace_back();
+            res.nodes[it.dst].child[q] = child;
+            if (it.src >= 0 && nodes[it.src].child[q]) {
+                uint32_t src = nodes[it.src].child[q];
+                stack.push_back({child, src, nodes[src].sum, it.depth + 1});
+            } else {
+                // energy of leaf quadrant is spread uniformly over its children
+                float quarter = it.sum[q] / 4;
+                stack.push_back({child, -1, {quarter, quarter, quarter, quarter}, it.depth + 1});
+            }
+        }
+    }
+    return res;
+}
+
+GuidingField::GuidingField(const AABB &bounds) : bounds(bounds), nodes(1), leaves(1) {}
+
+uint32_t GuidingField::find(const Vec3<float> &pos) const {
+    Vec3<float> size = bounds.size();
+    Vec3<float> p = ((pos - bounds.Min) / max(size, Vec3<float>(1e-6))).clamp(Vec3<float>(0), Vec3<float>(one_minus_eps));
+    uint32_t node = 0;
+    while (nodes[node].child) {
+        float &c = coord(p, nodes[node].axis);
+        int side = c >= 0.5f;
+        c = std::min(c * 2 - side, one_minus_eps);
+        node = nodes[node].child + side;
+    }
+    return node;
+}
+
+const DTree *GuidingField::lookup(const Vec3<float> &pos) const {
+    const DTree &tree = leaves[nodes[find(pos)].leaf].sampling;
+    return tree.total() > 0 ? &tree : nullptr;
+}
+
+// exponent bits test, std::isfinite folds to true under -Ofast (finite math only)
+static bool is_finite(float v) {
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return (bits & 0x7f800000u) != 0x7f800000u;
+}
+
+void GuidingField::record(const std::vector<GuideRecord> &records) {
+    for (auto &r : records) {
+        if (!is_finite(r.value) || r.value < 0) continue;
+        leaves[nodes[find(r.pos)].leaf].building.record(r.dir, r.value);
+    }
+}
+
+void GuidingField::split(uint32_t node, uint32_t threshold) {
+    uint32_t leaf = nodes[node].leaf;
+    if (leaves[leaf].building.samples <= threshold) return;
+
+    // both halves start from parent data with half of its samples
+    leaves[leaf].building.samples /= 2;
+    leaves[leaf].sampling.samples /= 2;
+    uint32_t child = nodes.size();
+    int axis = (nodes[node].axis + 1) % 3;
+    nodes[node].child = child;
+    nodes.push_back({0, leaf, axis});
+    nodes.push_back({0, uint32_t(leaves.size()), axis});
+    leaves.push_back(leaves[leaf]);
+    split(child, threshold);
+    split(child + 1, threshold);
+}
+
+void GuidingField::refine(int iteration) {
+    uint32_t threshold = spatial_threshold * sqrtf(1u << iteration);
+    for (uint32_t node = 0, n = nodes.size(); node < n; ++node) {
+        if (!nodes[node].child) {
+            split(node, threshold);
+        }
+    }
+    for (auto &leaf : leaves) {
+        leaf.sampling = std::move(leaf.building);
+        leaf.building = leaf.sampling.refined(energy_threshold, max_dtree_depth);
+
+    }
+}
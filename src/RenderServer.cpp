@@ -0,0 +1,129 @@
+#include "RenderServer.h"
+#include "Tonemap.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RenderServer::RenderServer(Scene &scene) : scene(scene), base_setup(scene.setup), base_camera(scene.camera) {}
+
+std::string RenderServer::handle(const std::string &request) {
+    try {
+        json r = json::parse(request);
+        std::string output = r.at("output");
+        Setup setup = base_setup;
+        long long width = r.at("width"), height = r.at("height"), spp = r.at("spp");
+        if (width < 1 || width > UINT16_MAX || height < 1 || height > UINT16_MAX) {
+            throw std::logic_error("width and height must be from 1 to 65535");
+        }
+        // setup counts samples in pairs, as spp argument of command line
+        if (spp < 2 || spp / 2 > UINT16_MAX) {
+            throw std::logic_error("spp must be from 2 to 131071");
+        }
+        setup.dimensions = {width, height};
+        setup.samples = spp / 2;
+        setup.ray_depth = r.value("depth", setup.ray_depth);
+        setup.rr_depth = r.value("rr-depth", setup.rr_depth);
+        setup.seed = r.value("seed", setup.seed);
+        setup.adaptive_threshold = r.value("adaptive", setup.adaptive_threshold);
+        setup.time_budget = r.value("time", setup.time_budget);
+        setup.target_error = r.value("target-error", setup.target_error);
+        int pass = r.value("pass", int(setup.pass_samples));
+        setup.guiding = r.value("guiding", setup.guiding);
+        if (r.contains("sampler")) {
+            setup.sequence = sequence_by_name(r["sampler"]);
+        }
+        if (pass < 1 || pass > UINT16_MAX) {
+            throw std::logic_error("progressive pass must take from 1 to 65535 samples");
+        }
+        setup.pass_samples = pass;
+
+        Camera camera = read_camera(r.value("camera", json::object()), base_camera);
+        camera.calc_fov_x(setup.dimensions.first, setup.dimensions.second);
+
+        // clients are served concurrently, renders one after another
+        std::lock_guard<std::mutex> lock(render_mutex);
+        scene.setup = setup;
+        scene.camera = camera;
+        Framebuffer frame = scene.render_scene();
+        std::ofstream out(output);
+        if (!out) {
+            throw std::logic_error("can not write " + output);
+        }
+        tonemap(frame).write_ppm(std::move(out));
+        return json{{"output", output}, {"stats", scene.stats.to_json()}}.dump();
+    } catch (const std::exception &e) {
+        return json{{"error", e.what()}}.dump();
+    }
+}
+
+void RenderServer::serve(std::istream &in, std::ostream &out) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        out << handle(line) << std::endl;
+    }
+}
+
+static bool write_all(int fd, const std::string &data) {
+    for (size_t done = 0; done < data.size(); ) {
+        // client may be gone, no SIGPIPE for it
+        ssize_t n = send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+void RenderServer::serve_socket(const std::string &path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::logic_error("socket path is too long: " + path);
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+    // stale socket of previous server is replaced, any other file is kept
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            throw std::logic_error(path + " exists and is not a socket");
+        }
+        unlink(path.c_str());
+    }
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || bind(server, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(server, 16) != 0) {
+        throw std::logic_error("can not listen on " + path);
+    }
+    std::cerr << "Listening on " << path << '\n';
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+        // idle client does not hold up others
+        std::thread([this, client] {
+            serve_client(client);
+            close(client);
+        }).detach();
+    }
+}
+
+void RenderServer::serve_client(int client) {
+    std::string buffer;
+    char chunk[4096];
+    while (true) {
+        ssize_t n = read(client, chunk, sizeof(chunk));
+        if (n <= 0) return;
+        buffer.append(chunk, n);
+        size_t end;
+        while ((end = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            if (line.empty()) continue;
+            if (!write_all(client, handle(line) + '\n')) return;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "RenderStats.h"
+#include "Parallel.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+void RenderStats::start(uint64_t samples_target_, float time_budget_) {
+    threads = std::vector<ThreadCounters>(max_threads());
+    start_time = std::chrono::steady_clock::now();
+    samples_target = samples_target_;
+    time_budget = time_budget_;
+    last_report = 0;
+    finished = -1;
+}
+
+void RenderStats::finish() {
+    finished = elapsed();
+}
+
+void RenderStats::add(const RayCounts &counts) {
+    // only owner thread writes its line
+    ThreadCounters &local = threads[thread_num() % threads.size()];
+    local.samples.fetch_add(counts.samples, std::memory_order_relaxed);
+    local.camera_rays.fetch_add(counts.camera_rays, std::memory_order_relaxed);
+    local.bounce_rays.fetch_add(counts.bounce_rays, std::memory_order_relaxed);
+    local.shadow_rays.fetch_add(counts.shadow_rays, std::memory_order_relaxed);
+}
+
+RayCounts RenderStats::total() const {
+    RayCounts res;
+    for (auto &t : threads) {
+        res.samples += t.samples.load(std::memory_order_relaxed);
+        res.camera_rays += t.camera_rays.load(std::memory_order_relaxed);
+        res.bounce_rays += t.bounce_rays.load(std::memory_order_relaxed);
+        res.shadow_rays += t.shadow_rays.load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+double RenderStats::elapsed() const {
+    if (finished >= 0) return finished;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void RenderStats::report(double interval) {
+    std::unique_lock lock(report_lock, std::try_to_lock);
+    double now = elapsed();
+    if (!lock.owns_lock() || now - last_report < interval) return;
+    last_report = now;
+
+    RayCounts t = total();
+    // done part of work by samples or by time, whichever ends first
+    double done = 0;
+    if (samples_target > 0) done = 1.0 * t.samples / samples_target;
+    if (time_budget > 0) done = std::max(done, now / time_budget);
+    done = std::min(done, 1.0);
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1);
+    if (done > 0) line << "Progress " << 100 * done << "%, ";
+    line << std::setprecision(2) << t.samples / now / 1e6 << "M samples/s, rays/s: "
+         << "camera " << t.camera_rays / now / 1e6 << "M, "
+         << "bounce " << t.bounce_rays / now / 1e6 << "M, "
+         << "shadow " << t.shadow_rays / now / 1e6 << "M; "
+         << std::setprecision(1) << "elapsed " << now << "s";
+    if (done > 0) line << ", ETA " << now * (1 - done) / done << "s";
+    line << '\n';
+    std::cerr << line.str();
+}
+
+nlohmann::json RenderStats::to_json() const {
+    RayCounts t = total();
+    double time = elapsed();
+    return {
+        {"elapsed_seconds", time},
+        {"threads", threads.size()},
+        {"samples", t.samples},
+        {"rays", {
+            {"camera", t.camera_rays},
+            {"bounce", t.bounce_rays},
+            {"shadow", t.shadow_rays},
+            {"total", t.rays()}
+        }},
+        {"samples_per_second", t.samples / time},
+        {"rays_per_second", {
+            {"camera", t.camera_rays / time},
+            {"bounce", t.bounce_rays / time},
+            {"shadow", t.shadow_rays / time},
+            {"total", t.rays() / time}
+        }}
+    };
+}
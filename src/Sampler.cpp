@@ -0,0 +1,15 @@
+#include "Sampler.h"
+#include "Sequences.h"
+
+float Sampler::next_ld() {
+    uint32_t dim = rng.counter++;
+    if (sequence == SampleSequence::Sobol) {
+        return sobol_owen(sample, dim / 2, dim % 2, pixel_seed);
+    }
+    // same point set for every pixel, Cranley-Patterson rotated by blue noise,
+    // mask is toroidally shifted per dimension to decorrelate them
+    float u = sobol_owen(sample, dim / 2, dim % 2, pixel_seed);
+    uint32_t shift = pcg_hash(dim + pixel_seed);
+    u += blue_noise(x + (shift & 0xffff), y + (shift >> 16));
+    return u >= 1 ? u - 1 : u;
+}
@@ -1,8 +1,13 @@
 #include "Camera.h"
 #include "Object.h"
 #include "Primitives.h"
-#include "Rnd.h"
+#include "Sampler.h"
 #include "Distribution.h"
+#include "AdaptiveSampling.h"
+#include "Tiles.h"
+#include "Parallel.h"
+#include "RenderStats.h"
+#include "Checkpoint.h"
 
 #include "Scene.h"
 
@@ -15,93 +20,377 @@
 #include <memory>
 #include <vector>
 #include <atomic>
-
-using namespace std::placeholders;
+#include <chrono>
+#include <mutex>
+#include <filesystem>
 
 using namespace BVH_bounds;
 
 Scene::Scene(SceneBuilder&& builder) : objs(std::move(builder.objs)), setup(std::move(builder.setup)), camera(std::move(builder.camera)) {
-    std::vector<std::shared_ptr<LightDistribution>> dists;
+    std::vector<EmissiveTriangle> lights;
 
     for (auto& i : objs) {
         if (i.material->emission.len() <= 1e-5) continue;
         if (auto t = std::dynamic_pointer_cast<Triangle>(i.geometry)) {
-            dists.push_back(std::make_unique<TriangleDistribution>(t));
+            i.light_id = lights.size();
+            lights.emplace_back(*t, i.material->emission);
         }
     }
 
-    light_pdf = std::make_unique<MixedDistribution>(std::move(dists));
-
-    bvh = BVH(std::nullopt, objs.begin(), objs.end());
+    // light distribution and BVH only read objs, build them side by side
+    run_tasks([&] {
+#pragma omp task shared(lights)
+        light_pdf = std::make_unique<LightsDistribution>(std::move(lights));
+        bvh = BVH(std::nullopt, objs.begin(), objs.end());
+#pragma omp taskwait
+    });
 }
 
 
-std::vector<std::vector<Vec3<float>>> Scene::render_scene() {
-    std::vector<std::vector<Vec3<float>>> output(setup.dimensions.second, std::vector<Vec3<float>>(setup.dimensions.first));
-    std::atomic_size_t samples_processed = 0;
-    size_t samples_total = setup.dimensions.first * setup.dimensions.second * setup.samples;
-    auto start_clock = clock();
+Framebuffer Scene::render_scene(TileWriter *output) {
+    auto [width, height] = setup.dimensions;
+    Framebuffer frame(width, height);
+    if (setup.resume && std::filesystem::exists(setup.checkpoint_path)) {
+        frame = load_checkpoint(setup.checkpoint_path, setup);
+        std::cerr << "Resumed from checkpoint " << setup.checkpoint_path << '\n';
+    }
+    std::vector<uint32_t> alloc;
+    bool progressive = setup.time_budget > 0 || setup.target_error > 0;
+    size_t taken = 0;
+    for (size_t i = 0; i < frame.size(); ++i) {
+        taken += frame[i].count;
+    }
+    stats.start(frame.size() * setup.samples - std::min(taken, frame.size() * setup.samples), setup.time_budget);
+    auto out_of_time = [&] {
+        return setup.time_budget > 0 && stats.elapsed() >= setup.time_budget;
+    };
     std::cerr << "Start rendering scene with following setup:\n";
-    std::cerr << "Output resolution: " << setup.dimensions.first << 'x' << setup.dimensions.second << std::endl;
-    std::cerr << "Samples per pixel: " << setup.samples << std::endl;
-    std::cerr << "Object primitives in scene: " << objs.size() << std::endl;
-    for (uint16_t x = 0; x < setup.dimensions.first; ++x) {
-#pragma omp parallel for schedule(dynamic)
-        for (uint16_t y = 0; y < setup.dimensions.second; ++y) {
-            Vec3<float> pixel = {0, 0, 0};
-            for (uint16_t sample = 0; sample < setup.samples; ++sample) {
-                float x_01 = (x + Rnd::getRnd()->uniform(0, 1)) / setup.dimensions.first;
-                float y_01 = (y + Rnd::getRnd()->uniform(0, 1)) / setup.dimensions.second;
-                float x_11 = x_01 * 2 - 1;
-                float y_11 = y_01 * 2 - 1;
-                pixel = pixel + raycast(camera.raycast(x_11, -y_11), setup.ray_depth);
-                samples_processed++;
+    std::cerr << "Output resolution: " << setup.dimensions.first << 'x' << setup.dimensions.second << '\n';
+    std::cerr << "Samples per pixel: " << setup.samples << '\n';
+    if (setup.time_budget > 0) {
+        std::cerr << "Time budget: " << setup.time_budget << "s\n";
+    }
+    if (setup.target_error > 0) {
+        std::cerr << "Target error: " << setup.target_error << '\n';
+    }
+    std::cerr << "Object primitives in scene: " << objs.size() << '\n';
+
+    std::vector<Tile> tiles = make_tiles(width, height);
+    if (output && setup.resume) {
+        // tiles that take no more samples still show up
+        for (const Tile &tile : tiles) {
+            output->push(frame.view(tile));
+        }
+    }
+    double last_checkpoint = 0;
+    std::mutex checkpoint_lock;
+
+    // adds alloc[p] samples to every pixel, training passes also feed guiding
+    auto render_pass = [&] (bool train) {
+        TileQueue queue(tiles.size(), max_threads());
+        // records are deposited in tile order, so learned field does not depend on thread count
+        std::vector<std::vector<GuideRecord>> records(train ? tiles.size() : 0);
+        std::vector<uint8_t> done(tiles.size());
+        size_t flushed = 0;
+        std::mutex flush_lock;
+#pragma omp parallel
+        {
+            // tile is rendered into local copy and published under flush_lock,
+            // so frame is always consistent for checkpoints
+            std::vector<PixelStats> local;
+            Framebuffer snapshot;
+            size_t t;
+            while (queue.pop(thread_num(), t)) {
+                TileView view = frame.view(tiles[t]);
+                const Tile &tile = tiles[t];
+                local.resize(tile.area());
+                TileView local_view = {local.data(), tile.width(), tile};
+                RayCounts counts;
+                // deadline is checked per tile, pixels keep their own sample count.
+                // Past it only pixels without samples take one, so image has no holes
+                bool late = out_of_time();
+                for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                    std::copy_n(&view.at(tile.x0, y), tile.width(), &local_view.at(tile.x0, y));
+                }
+                for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                    for (uint16_t x = tile.x0; x < tile.x1; ++x) {
+                        PixelStats &pixel = local_view.at(x, y);
+                        uint32_t n = alloc[y * width + x];
+                        if (late) {
+                            n = std::min(n, pixel.count == 0 ? 1u : 0u);
+                        }
+                        for (uint32_t i = 0; i < n; ++i) {
+                            // sample index continues from previous rounds
+                            Sampler sampler = make_sampler(x, y, pixel.count);
+                            pixel.add(raycast(camera_ray(x, y, sampler), sampler, counts, train ? &records[t] : nullptr));
+                        }
+                        counts.samples += n;
+                    }
+                }
+                stats.add(counts);
+                if (!progressive) {
+                    stats.report();
+                }
+
+                bool checkpoint = false;
+                {
+                    std::lock_guard lock(flush_lock);
+                    if (counts.samples > 0) {
+                        for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                            std::copy_n(&local_view.at(tile.x0, y), tile.width(), &view.at(tile.x0, y));
+                        }
+                    }
+                    done[t] = true;
+                    for (; flushed < tiles.size() && done[flushed]; ++flushed) {
+                        if (train) {
+                            guiding->record(records[flushed]);
+                            records[flushed] = {};
+                        }
+                    }
+                    if (!setup.checkpoint_path.empty() && stats.elapsed() - last_checkpoint >= setup.checkpoint_interval) {
+                        last_checkpoint = stats.elapsed();
+                        snapshot = frame;
+                        checkpoint = true;
+                    }
+                }
+                if (output && counts.samples > 0) {
+                    output->push(local_view);
+                }
+                // file is written outside of flush_lock, other threads keep rendering
+                // failed periodic checkpoint must not end the render, exception
+                // can not leave parallel region anyway; final save reports errors
+                if (checkpoint) {
+                    std::lock_guard lock(checkpoint_lock);
+                    try {
+                        save_checkpoint(setup.checkpoint_path, snapshot, setup);
+                    } catch (const std::exception &e) {
+                        std::cerr << "Checkpoint skipped: " << e.what() << '\n';
+                    }
+                }
             }
-            output[y][x] = postprocess(pixel / setup.samples);
         }
-        std::cerr << samples_processed << ' ' << samples_total << std::endl;
-        std::cerr << "Generated " << std::fixed << std::setprecision(4) << 100 * 1.0 * samples_processed / samples_total << "% of samples\n";
-        std::cerr << "Spent time: " << 0.25 * (clock() - start_clock) / CLOCKS_PER_SEC << std::endl;
+    };
+
+    uint32_t trained = 0;
+    scatter_pdf = &bsdf_pdf;
+    if (setup.guiding) {
+        AABB bounds;
+        for (auto &obj : objs) {
+            bounds.extend(obj.geometry->get_aabb());
+        }
+        guiding = std::make_unique<GuidingField>(bounds);
+        guided_pdf = std::make_unique<GuidedDistribution>(*guiding);
+        scatter_pdf = guided_pdf.get();
+        // iterations of doubling spp over at most a quarter of budget,
+        // samples taken while training stay in the image
+        for (int k = 0; k < 6 && trained + (1u << k) <= setup.samples / 4u && !out_of_time(); ++k) {
+            std::cerr << "Guiding training pass " << k << ", " << (1u << k) << " spp\n";
+            alloc.resize(frame.size());
+            for (size_t i = 0; i < frame.size(); ++i) {
+                alloc[i] = std::min<uint32_t>(1u << k, setup.samples - std::min<uint32_t>(frame[i].count, setup.samples));
+            }
+            render_pass(true);
+            guiding->refine(k);
+            trained += 1u << k;
+        }
+    }
+
+    std::unique_ptr<SampleSchedule> schedule;
+    if (progressive) {
+        schedule = std::make_unique<ProgressiveSchedule>(frame.size(), setup.pass_samples, setup.samples, setup.target_error, setup.adaptive_threshold);
+    } else {
+        schedule = std::make_unique<SampleAllocator>(frame, setup.samples, setup.adaptive_threshold);
+    }
+    // first round always runs, it covers pixels that training did not reach
+    for (int round = 0; (round == 0 || !out_of_time()) && schedule->next_round(frame, alloc); ++round) {
+        if (progressive) {
+            std::cerr << "Pass " << round << ", mean error " << static_cast<ProgressiveSchedule&>(*schedule).mean_error << '\n';
+            stats.report(0);
+        } else if (setup.adaptive_threshold > 0) {
+            std::cerr << "Adaptive sampling round " << round << '\n';
+        }
+        render_pass(false);
+    }
+    stats.finish();
+    stats.report(0);
+    if (!setup.checkpoint_path.empty()) {
+        save_checkpoint(setup.checkpoint_path, frame, setup);
     }
-    return output;
+    return frame;
 }
 
-// x, y in [-1, 1]
-Vec3<float> Scene::postprocess(Vec3<float> in_color) {
-    return gamma_correction(aces_tonemap(in_color));
+std::vector<Framebuffer> Scene::render_batch(const std::vector<Camera> &views) {
+    auto [width, height] = setup.dimensions;
+    // every frame is first touched by render threads, copies would not be
+    std::vector<Framebuffer> frames;
+    for (size_t v = 0; v < views.size(); ++v) {
+        frames.emplace_back(width, height);
+    }
+    std::vector<Tile> tiles = make_tiles(width, height);
+    scatter_pdf = &bsdf_pdf;
+    stats.start(frames.size() * width * height * setup.samples);
+    std::cerr << "Start rendering " << views.size() << " views, " << width << 'x' << height
+              << ", " << setup.samples << " samples per pixel\n";
+
+    // item j is tile j % tiles.size() of view j / tiles.size()
+    TileQueue queue(views.size() * tiles.size(), max_threads());
+#pragma omp parallel
+    {
+        // samples accumulate in buffer of the thread, frame is written once per tile
+        std::vector<PixelStats> local;
+        size_t j;
+        while (queue.pop(thread_num(), j)) {
+            size_t v = j / tiles.size();
+            const Tile &tile = tiles[j % tiles.size()];
+            TileView view = frames[v].view(tile);
+            local.assign(tile.area(), PixelStats());
+            TileView local_view = {local.data(), tile.width(), tile};
+            RayCounts counts;
+            for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                for (uint16_t x = tile.x0; x < tile.x1; ++x) {
+                    PixelStats &pixel = local_view.at(x, y);
+                    for (uint32_t i = 0; i < setup.samples; ++i) {
+                        Sampler sampler = make_sampler(x, y, pixel.count);
+                        pixel.add(raycast(camera_ray(views[v], x, y, sampler), sampler, counts));
+                    }
+                    counts.samples += setup.samples;
+                }
+            }
+            for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+                std::copy_n(&local_view.at(tile.x0, y), tile.width(), &view.at(tile.x0, y));
+            }
+            stats.add(counts);
+            stats.report();
+        }
+    }
+    stats.finish();
+    stats.report(0);
+    return frames;
 }
 
-Vec3<float> Scene::aces_tonemap(const Vec3<float> &x) {
-    const float a = 2.51;
-    const float b = 0.03;
-    const float c = 2.43;
-    const float d = 0.59;
-    const float e = 0.14;
-    return (x*(x*a+b))/(x*(x*c+d)+e);
+static float power_heuristic(float pdf, float oth_pdf) {
+    return pdf * pdf / (pdf * pdf + oth_pdf * oth_pdf);
 }
 
-Vec3<float> Scene::gamma_correction(const Vec3<float> &x) {
-    return saturate(pow(x, 1 / 2.2));
+Sampler Scene::make_sampler(uint16_t x, uint16_t y, uint32_t sample) const {
+    return Sampler(setup.sequence, x, y, setup.first_sample + sample, setup.seed);
 }
 
-Vec3<float> Scene::saturate(const Vec3<float> &color) {
-    return color.clamp(Vec3<float>(0), Vec3<float>(1));
+Ray Scene::camera_ray(uint16_t x, uint16_t y, Sampler &sampler) {
+    return camera_ray(camera, x, y, sampler);
 }
 
-Vec3<float> Scene::raycast(const Ray& ray, int ttl) {
-    if (ttl == 0) {
-        return setup.bg_color;
-    }
-    auto tmp = get_intersect(ray);
-    if (tmp) {
+Ray Scene::camera_ray(const Camera &view, uint16_t x, uint16_t y, Sampler &sampler) const {
+    sampler.start(0, SampleSlot::Camera);
+    auto [dx, dy] = sampler.uniform_2d();
+    float x_01 = (x + dx) / setup.dimensions.first;
+    float y_01 = (y + dy) / setup.dimensions.second;
+    float x_11 = x_01 * 2 - 1;
+    float y_11 = y_01 * 2 - 1;
+    return view.raycast(x_11, -y_11);
+}
+
+Vec3<float> Scene::raycast(Ray ray, Sampler &sampler, RayCounts &counts, std::vector<GuideRecord> *records) {
+    Vec3<float> radiance(0);
+    Vec3<float> throughput(1);
+    // pdf of the last sampled direction, 0 for camera ray and after delta bounce
+    float last_pdf = 0;
+    // non-delta vertices for guiding: radiance gathered before and throughput after them
+    struct GuideVertex {
+        Vec3<float> pos, dir;
+        float pdf;
+        Vec3<float> radiance, throughput;
+    };
+    std::vector<GuideVertex> vertices;
+    bool escaped = true;
+    for (int depth = 0; depth < setup.ray_depth; ++depth) {
+        auto tmp = get_intersect(ray);
+        (depth == 0 ? counts.camera_rays : counts.bounce_rays)++;
+        if (!tmp) {
+            break;
+        }
         auto& [obj, intersect] = tmp.value();
-        auto raycast_fn = std::bind(&Scene::raycast, this, _1, ttl - 1);
-        return obj.material->sample(ray, intersect, *light_pdf.get(), raycast_fn);
-    } else {
-        return setup.bg_color;
+        sampler.start(depth, SampleSlot::Bsdf);
+        Scatter scatter = obj.material->sample(ray, intersect, *scatter_pdf, sampler);
+        if (scatter.emission.len() > 1e-5) {
+            radiance = radiance + throughput * scatter.emission * emission_weight(last_pdf, ray, intersect, obj.light_id);
+        }
+        if (scatter.pdf > 0 && depth + 1 < setup.ray_depth) {
+            sampler.start(depth, SampleSlot::Light);
+            auto conn = connect_light(ray, intersect, *obj.material, sampler);
+            if (conn) {
+                counts.shadow_rays++;
+                if (!occluded(conn->shadow, conn->t_max)) {
+                    radiance = radiance + throughput * conn->radiance;
+                }
+            }
+        }
+        if (!scatter.ray) {
+            escaped = false;
+            break;
+        }
+        throughput = throughput * scatter.weight;
+        if (records && scatter.pdf > 0) {
+            vertices.push_back({scatter.ray->start, scatter.ray->v, scatter.pdf, radiance, throughput});
+        }
+        last_pdf = scatter.pdf;
+        ray = *scatter.ray;
+        if (!roulette(throughput, depth, sampler)) {
+            escaped = false;
+            break;
+        }
+    }
+    if (escaped) {
+        radiance = radiance + throughput * setup.bg_color;
+    }
+    // everything gathered after vertex came along its sampled direction
+    for (auto &v : vertices) {
+        Vec3<float> incident = (radiance - v.radiance) / max(v.throughput, Vec3<float>(1e-6));
+        records->push_back({v.pos, v.dir, luminance(incident) / v.pdf});
     }
+    return radiance;
+}
+
+float Scene::emission_weight(float last_pdf, const Ray &ray, const Intersection &i, int32_t light_id) {
+    if (last_pdf <= 0 || light_id < 0) {
+        return 1;
+    }
+    // light is also reachable by next event estimation from previous vertex
+    return power_heuristic(last_pdf, light_pdf->pdf(light_id, ray.v, i.t));
+}
+
+std::optional<LightConnection> Scene::connect_light(const Ray &w_in, const Intersection &i, const Material &material, Sampler &sampler) {
+    Ray r = {w_in.reveal(i.t), i.normal};
+    r.bump();
+    Vec3<float> pos = r.start;
+
+    auto light = light_pdf->sample_light(pos, sampler);
+    if (!light || light->dir % i.normal <= 1e-6) {
+        return std::nullopt;
+    }
+    float bsdf = scatter_pdf->pdf(pos, i.normal, light->dir);
+    Vec3<float> radiance = material.eval(w_in, i, light->dir) * light->emission * power_heuristic(light->pdf, bsdf) / light->pdf;
+    return LightConnection {{pos, light->dir}, light->t * (1 - 1e-4f), radiance};
+}
+
+bool Scene::roulette(Vec3<float> &throughput, int depth, Sampler &sampler) {
+    if (depth + 1 < setup.rr_depth) {
+        return true;
+    }
+    // survive with probability proportional to throughput, keep estimator unbiased
+    sampler.start(depth, SampleSlot::Roulette);
+    float survival = std::min(throughput.max(), 0.95f);
+    if (sampler.uniform(0, 1) >= survival) {
+        return false;
+    }
+    throughput = throughput / survival;
+    return true;
 }
 
 std::optional<std::pair<Object, Intersection>> Scene::get_intersect(const Ray& ray) {
     return bvh.get_intersect(ray, true);
 }
+
+bool Scene::occluded(const Ray& ray, float t_max) {
+    return bvh.occluded(ray, t_max);
+}
@@ -0,0 +1,101 @@
+#include "Sequences.h"
+#include "CounterRng.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+const int mask_size = 64;
+const int kernel_radius = 6;
+const float sigma = 1.5;
+
+// Void-and-cluster dither array, Ulichney 1993
+struct BlueNoiseMask {
+    std::vector<float> value;
+    std::vector<uint8_t> pattern;
+    std::vector<float> energy;
+    float kernel[2 * kernel_radius + 1][2 * kernel_radius + 1];
+
+    BlueNoiseMask() : value(mask_size * mask_size), pattern(mask_size * mask_size), energy(mask_size * mask_size) {
+        for (int dy = -kernel_radius; dy <= kernel_radius; ++dy) {
+            for (int dx = -kernel_radius; dx <= kernel_radius; ++dx) {
+                kernel[dy + kernel_radius][dx + kernel_radius] = exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+            }
+        }
+
+        const int n = mask_size * mask_size;
+        int ones = 0;
+        for (int i = 0; i < n; ++i) {
+            if (pcg_hash(uint32_t(i)) % 10 == 0) {
+                set(i, 1);
+                ones++;
+            }
+        }
+        // relax initial pattern: move tightest clusters into largest voids
+        while (true) {
+            int cluster = tightest_cluster();
+            set(cluster, 0);
+            int v = largest_void();
+            set(v, 1);
+            if (v == cluster) break;
+        }
+        std::vector<uint8_t> initial = pattern;
+        std::vector<float> initial_energy = energy;
+
+        std::vector<int> rank(n);
+        for (int r = ones - 1; r >= 0; --r) {
+            int cluster = tightest_cluster();
+            set(cluster, 0);
+            rank[cluster] = r;
+        }
+        pattern = initial;
+        energy = initial_energy;
+        for (int r = ones; r < n; ++r) {
+            int v = largest_void();
+            set(v, 1);
+            rank[v] = r;
+        }
+        for (int i = 0; i < n; ++i) {
+            value[i] = (rank[i] + 0.5f) / n;
+        }
+    }
+
+    void set(int idx, uint8_t bit) {
+        if (pattern[idx] == bit) return;
+        pattern[idx] = bit;
+        float sign = bit ? 1 : -1;
+        int x = idx % mask_size, y = idx / mask_size;
+        for (int dy = -kernel_radius; dy <= kernel_radius; ++dy) {
+            for (int dx = -kernel_radius; dx <= kernel_radius; ++dx) {
+                int px = (x + dx + mask_size) % mask_size;
+                int py = (y + dy + mask_size) % mask_size;
+                energy[py * mask_size + px] += sign * kernel[dy + kernel_radius][dx + kernel_radius];
+            }
+        }
+    }
+
+    int tightest_cluster() const {
+        int best = -1;
+        for (int i = 0; i < int(pattern.size()); ++i) {
+            if (pattern[i] && (best == -1 || energy[i] > energy[best])) best = i;
+        }
+        return best;
+    }
+
+    int largest_void() const {
+        int best = -1;
+        for (int i = 0; i < int(pattern.size()); ++i) {
+            if (!pattern[i] && (best == -1 || energy[i] < energy[best])) best = i;
+        }
+        return best;
+    }
+};
+
+}
+
+float blue_noise(uint32_t x, uint32_t y) {
+    static const BlueNoiseMask mask;
+    return mask.value[(y % mask_size) * mask_size + x % mask_size];
+}
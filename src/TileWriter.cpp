@@ -0,0 +1,90 @@
+#include "TileWriter.h"
+#include "Tonemap.h"
+#include "Image.h"
+
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+TileWriter::TileWriter(const std::string &path, uint16_t width, uint16_t height)
+    : path(path), width(width), height(height) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::logic_error("can not write " + path);
+    }
+    std::string head = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+    header = head.size();
+    struct stat st;
+    bool ok = pwrite(fd, head.data(), head.size(), 0) == ssize_t(head.size());
+    // black image of full size, devices like /dev/null can not be resized
+    if (ok && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        ok = ftruncate(fd, header + size_t(width) * height * 3) == 0;
+    }
+    if (!ok) {
+        close(fd);
+        throw std::logic_error("can not write " + path);
+    }
+    worker = std::thread(&TileWriter::run, this);
+}
+
+TileWriter::~TileWriter() {
+    if (worker.joinable()) {
+        try {
+            finish();
+        } catch (const std::exception &) {}
+    }
+}
+
+void TileWriter::push(const TileView &view) {
+    const Tile &tile = view.tile;
+    Job job = {tile, std::vector<Vec3<float>>(tile.area())};
+    for (uint16_t y = tile.y0; y < tile.y1; ++y) {
+        for (uint16_t x = tile.x0; x < tile.x1; ++x) {
+            job.mean[(y - tile.y0) * tile.width() + x - tile.x0] = view.at(x, y).mean();
+        }
+    }
+    {
+        std::lock_guard guard(lock);
+        // pending older copy of tile is not written at all
+        jobs[{tile.y0, tile.x0}] = std::move(job);
+    }
+    ready.notify_one();
+}
+
+void TileWriter::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock guard(lock);
+            ready.wait(guard, [&] { return closing || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.begin()->second);
+            jobs.erase(jobs.begin());
+        }
+        // same quantization as whole image
+        Image row(job.tile.width(), 1);
+        for (uint16_t y = job.tile.y0; y < job.tile.y1; ++y) {
+            for (uint16_t x = 0; x < row.width; ++x) {
+                row.set(x, 0, tonemap(job.mean[(y - job.tile.y0) * row.width + x]));
+            }
+            off_t offset = header + (size_t(y) * width + job.tile.x0) * 3;
+            if (pwrite(fd, row.pixels.data(), row.pixels.size(), offset) != ssize_t(row.pixels.size())) {
+                failed = true;
+            }
+        }
+    }
+}
+
+void TileWriter::finish() {
+    {
+        std::lock_guard guard(lock);
+        closing = true;
+    }
+    ready.notify_one();
+    worker.join();
+    bool ok = close(fd) == 0 && !failed;
+    if (!ok) {
+        throw std::logic_error("failed to write " + path);
+    }
+}
@@ -0,0 +1,77 @@
+#include "Tiles.h"
+
+#include <algorithm>
+
+static uint32_t spread_bits(uint32_t x) {
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ffu;
+    x = (x | (x << 4)) & 0x0f0f0f0fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+
+std::vector<Tile> make_tiles(uint16_t width, uint16_t height, uint16_t size) {
+    std::vector<std::pair<uint32_t, Tile>> keyed;
+    for (uint32_t ty = 0; ty * size < height; ++ty) {
+        for (uint32_t tx = 0; tx * size < width; ++tx) {
+            Tile tile = {
+                uint16_t(tx * size), uint16_t(ty * size),
+                uint16_t(std::min<uint32_t>(width, (tx + 1) * size)),
+                uint16_t(std::min<uint32_t>(height, (ty + 1) * size))
+            };
+            keyed.push_back({spread_bits(tx) | (spread_bits(ty) << 1), tile});
+        }
+    }
+    std::sort(keyed.begin(), keyed.end(), [] (auto &a, auto &b) { return a.first < b.first; });
+
+    std::vector<Tile> tiles;
+    for (auto &[key, tile] : keyed) {
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+TileQueue::TileQueue(size_t tiles, int threads) : ranges(std::max(threads, 1)) {
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        ranges[i].begin = range_begin(tiles, ranges.size(), i);
+        ranges[i].end = range_begin(tiles, ranges.size(), i + 1);
+    }
+}
+
+bool TileQueue::pop(int thread, size_t &tile) {
+    Range &own = ranges[thread % ranges.size()];
+    {
+        std::lock_guard lock(own.lock);
+        if (own.begin < own.end) {
+            tile = own.begin++;
+            return true;
+        }
+    }
+    return steal(thread, tile);
+}
+
+bool TileQueue::steal(int thread, size_t &tile) {
+    while (true) {
+        // sizes are read without locks, victim is rechecked under its lock
+        size_t victim = ranges.size(), most = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            // own range is already drained, it never grows
+            if (i == thread % ranges.size()) continue;
+            size_t begin = ranges[i].begin.load(std::memory_order_relaxed);
+            size_t end = ranges[i].end.load(std::memory_order_relaxed);
+            if (begin < end && end - begin > most) {
+                victim = i;
+                most = end - begin;
+            }
+        }
+        if (victim == ranges.size()) return false;
+
+        Range &range = ranges[victim];
+        std::lock_guard lock(range.lock);
+        if (range.begin < range.end) {
+            tile = --range.end;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#include "Tonemap.h"
+
+static Vec3<float> aces_tonemap(const Vec3<float> &x) {
+    const float a = 2.51;
+    const float b = 0.03;
+    const float c = 2.43;
+    const float d = 0.59;
+    const float e = 0.14;
+    return (x*(x*a+b))/(x*(x*c+d)+e);
+}
+
+static Vec3<float> saturate(const Vec3<float> &color) {
+    return color.clamp(Vec3<float>(0), Vec3<float>(1));
+}
+
+static Vec3<float> gamma_correction(const Vec3<float> &x) {
+    return saturate(pow(x, 1 / 2.2));
+}
+
+Vec3<float> tonemap(const Vec3<float> &linear) {
+    return gamma_correction(aces_tonemap(linear));
+}
+
+Image tonemap(const Framebuffer &frame) {
+    Image img(frame.width, frame.height);
+#pragma omp parallel for
+    for (uint16_t y = 0; y < frame.height; ++y) {
+        for (uint16_t x = 0; x < frame.width; ++x) {
+            img.set(x, y, tonemap(frame.at(x, y).mean()));
+        }
+    }
+    return img;
+}
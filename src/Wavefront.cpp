@@ -0,0 +1,190 @@
+#include "Wavefront.h"
+#include "Scene.h"
+#include "Primitives.h"
+#include "Sampler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <ctime>
+
+WavefrontRenderer::WavefrontRenderer(Scene &scene, size_t batch_size)
+    : scene(scene), batch_size(batch_size) {}
+
+void WavefrontRenderer::resize(size_t n) {
+    origin.resize(n);
+    dir.resize(n);
+    throughput.resize(n);
+    radiance.resize(n);
+    last_pdf.resize(n);
+    pixel.resize(n);
+    depth.resize(n);
+    alive.resize(n);
+    sampler.resize(n);
+    material.resize(n);
+    hit.resize(n);
+    light.resize(n);
+    has_shadow.resize(n);
+    shadow.resize(n);
+}
+
+void WavefrontRenderer::move_path(size_t to, size_t from) {
+    origin[to] = origin[from];
+    dir[to] = dir[from];
+    throughput[to] = throughput[from];
+    radiance[to] = radiance[from];
+    last_pdf[to] = last_pdf[from];
+    pixel[to] = pixel[from];
+    depth[to] = depth[from];
+    alive[to] = alive[from];
+    sampler[to] = sampler[from];
+}
+
+// Fill free slots of the batch with camera rays of next samples
+void WavefrontRenderer::generate() {
+    const Setup &setup = scene.setup;
+    size_t old_size = size();
+    size_t n = std::min(batch_size - old_size, samples_total - next_sample);
+    resize(old_size + n);
+#pragma omp parallel for
+    for (size_t i = old_size; i < old_size + n; ++i) {
+        size_t p = (next_sample + i - old_size) / setup.samples;
+        uint16_t x = p % setup.dimensions.first, y = p / setup.dimensions.first;
+        sampler[i] = scene.make_sampler(x, y, (next_sample + i - old_size) % setup.samples);
+        Ray ray = scene.camera_ray(x, y, sampler[i]);
+        origin[i] = ray.start;
+        dir[i] = ray.v;
+        throughput[i] = Vec3<float>(1);
+        radiance[i] = Vec3<float>(0);
+        last_pdf[i] = 0;
+        pixel[i] = p;
+        depth[i] = 0;
+        alive[i] = true;
+    }
+    next_sample += n;
+}
+
+// Closest hit for every path
+void WavefrontRenderer::extend() {
+    uint64_t camera = 0, bounce = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:camera, bounce)
+    for (size_t i = 0; i < size(); ++i) {
+        (depth[i] == 0 ? camera : bounce)++;
+        auto tmp = scene.get_intersect({origin[i], dir[i]});
+        if (tmp) {
+            material[i] = tmp->first.material.get();
+            light[i] = tmp->first.light_id;
+            hit[i] = tmp->second;
+        } else {
+            material[i] = nullptr;
+        }
+    }
+    counts.camera_rays += camera;
+    counts.bounce_rays += bounce;
+}
+
+// Sample materials grouped by type, queue light connections
+void WavefrontRenderer::shade() {
+    const Setup &setup = scene.setup;
+    order.resize(size());
+    for (size_t i = 0; i < size(); ++i) {
+        order[i] = {material[i], i};
+    }
+    std::sort(order.begin(), order.end());
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (size_t k = 0; k < order.size(); ++k) {
+        auto [mat, i] = order[k];
+        has_shadow[i] = false;
+        if (!mat) {
+            radiance[i] = radiance[i] + throughput[i] * setup.bg_color;
+            alive[i] = false;
+            continue;
+        }
+        Ray ray = {origin[i], dir[i]};
+        sampler[i].start(depth[i], SampleSlot::Bsdf);
+        Scatter scatter = mat->sample(ray, hit[i], *scene.scatter_pdf, sampler[i]);
+        if (scatter.emission.len() > 1e-5) {
+            radiance[i] = radiance[i] + throughput[i] * scatter.emission * scene.emission_weight(last_pdf[i], ray, hit[i], light[i]);
+        }
+        if (scatter.pdf > 0 && depth[i] + 1 < setup.ray_depth) {
+            sampler[i].start(depth[i], SampleSlot::Light);
+            auto conn = scene.connect_light(ray, hit[i], *mat, sampler[i]);
+            if (conn) {
+                conn->radiance = throughput[i] * conn->radiance;
+                shadow[i] = *conn;
+                has_shadow[i] = true;
+            }
+        }
+        if (!scatter.ray) {
+            alive[i] = false;
+            continue;
+        }
+        throughput[i] = throughput[i] * scatter.weight;
+        last_pdf[i] = scatter.pdf;
+        origin[i] = scatter.ray->start;
+        dir[i] = scatter.ray->v;
+        if (!scene.roulette(throughput[i], depth[i], sampler[i])) {
+            alive[i] = false;
+            continue;
+        }
+        if (++depth[i] >= setup.ray_depth) {
+            radiance[i] = radiance[i] + throughput[i] * setup.bg_color;
+            alive[i] = false;
+        }
+    }
+}
+
+// Trace queued shadow rays
+void WavefrontRenderer::connect() {
+    uint64_t shadows = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:shadows)
+    for (size_t i = 0; i < size(); ++i) {
+        if (!has_shadow[i]) continue;
+        shadows++;
+        if (!scene.occluded(shadow[i].shadow, shadow[i].t_max)) {
+            radiance[i] = radiance[i] + shadow[i].radiance;
+        }
+    }
+    counts.shadow_rays += shadows;
+}
+
+// Accumulate terminated paths and squeeze them out of the batch
+void WavefrontRenderer::compact() {
+    size_t n = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        if (alive[i]) {
+            move_path(n++, i);
+        } else {
+            accum.at(pixel[i] % accum.width, pixel[i] / accum.width).add(radiance[i]);
+            counts.samples++;
+        }
+    }
+    resize(n);
+}
+
+Framebuffer WavefrontRenderer::render() {
+    const Setup &setup = scene.setup;
+    auto [width, height] = setup.dimensions;
+    accum = Framebuffer(width, height);
+    next_sample = 0;
+    samples_total = size_t(width) * height * setup.samples;
+    resize(0);
+
+    scene.stats.start(samples_total);
+    std::cerr << "Start wavefront rendering with batch of " << batch_size << " paths\n";
+    while (next_sample < samples_total || size() > 0) {
+        generate();
+        extend();
+        shade();
+        connect();
+        compact();
+        // stages count on the calling thread, one add per iteration
+        scene.stats.add(counts);
+        counts = RayCounts();
+        scene.stats.report();
+    }
+    scene.stats.finish();
+    scene.stats.report(0);
+    return std::move(accum);
+}
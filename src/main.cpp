@@ -1,11 +1,73 @@
 #include <iostream>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
 
 #include "Image.h"
+#include "Tonemap.h"
 #include "Scene.h"
 #include "SceneBuilder.h"
+#include "Wavefront.h"
+#include "Checkpoint.h"
+#include "Distributed.h"
+#include "Parallel.h"
+#include "RenderServer.h"
+#include "Numa.h"
+#include "TileWriter.h"
 
 int main(int argc, char* argv[]) {
-    /* std::cout << "Usage: kengine <path to scene> <width> <height> <spp> <path for output p6 image>\n"; */
+    /* std::cout << "Usage: kengine <path to scene> <width> <height> <spp> [options] <path for output p6 image>\n"; */
+    /* std::cout << "Options:\n"; */
+    /* std::cout << "  --depth <n>     max path length (default 6)\n"; */
+    /* std::cout << "  --rr-depth <n>  path length after which russian roulette starts (default 3)\n"; */
+    /* std::cout << "  --wavefront     breadth-first renderer, advances batches of paths stage by stage\n"; */
+    /* std::cout << "  --sampler <s>   sample sequence: independent, sobol (default) or bluenoise\n"; */
+    /* std::cout << "  --seed <n>      random seed, output is bit-identical for same seed on any thread count\n"; */
+    /* std::cout << "  --adaptive <e>  spend spp budget adaptively, pixels with relative error below e stop\n"; */
+    /* std::cout << "  --checkpoint <path>  save accumulated samples periodically and at the end\n"; */
+    /* std::cout << "  --checkpoint-interval <s>  seconds between checkpoints, 300 by default\n"; */
+    /* std::cout << "  --resume        continue render from checkpoint to requested spp\n"; */
+    /* std::cout << "  --stats <path>  write render counters and timing as json\n"; */
+    /* std::cout << "  --sample-map <path>  dump per-pixel sample counts as p6 image\n"; */
+    /* std::cout << "  --time <s>      progressive mode, stop after s seconds of wall-clock time\n"; */
+    /* std::cout << "  --target-error <e>  progressive mode, stop when mean relative pixel error is below e\n"; */
+    /* std::cout << "  --guiding        learn incident light in first passes and guide diffuse bounces\n"; */
+    /* std::cout << "  --pass <n>      samples per pixel in one progressive pass, 4 by default\n"; */
+    /* std::cout << "  --samples <n>   exact samples per pixel, overrides <spp>\n"; */
+    /* std::cout << "  --first-sample <n>  index of first sample, workers of one render take disjoint ranges\n"; */
+    /* std::cout << "  --workers <n>   render in n local processes and merge their partial frames\n"; */
+    /* std::cout << "  --numa          pin threads to NUMA nodes, interleave scene memory over them\n"; */
+    /* std::cout << "  --all-cameras   render every camera of scene, image i goes to <output stem>_i<ext>\n"; */
+    /* std::cout << "  --batch <path>  render json list of views [{\"camera\": {...}, \"output\": path}], see read_camera\n"; */
+    /* std::cout << "   or: kengine --merge <path for output p6 image> <checkpoint>...\n"; */
+    /* std::cout << "  merge partial frames rendered by workers with --first-sample and --checkpoint\n"; */
+    /* std::cout << "   or: kengine --serve <path to scene> [<path of unix socket>]\n"; */
+    /* std::cout << "  load scene once and render json requests from stdin or socket, see RenderServer.h\n"; */
+
+    if (argc > 1 && std::string(argv[1]) == "--merge") {
+        if (argc < 4) {
+            throw std::logic_error("--merge needs output path and at least one checkpoint");
+        }
+        Framebuffer frame = merge_partials({argv + 3, argv + argc});
+        tonemap(frame).write_ppm(std::ofstream(argv[2]));
+        std::cerr << "Merged " << argc - 3 << " partial frames into " << argv[2] << '\n';
+        return 0;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--serve") {
+        std::filesystem::path scene_path(argv[2]);
+        std::ifstream fin(scene_path);
+        Setup setup = {6, 0, Vec3<float>(), Vec3<float>(), {1, 1}};
+        Scene scene(GltfBuilder(fin, scene_path.parent_path(), std::move(setup)));
+        std::cerr << "Scene parsed, waiting for requests\n";
+        RenderServer server(scene);
+        if (argc > 3) {
+            server.serve_socket(argv[3]);
+        } else {
+            server.serve(std::cin, std::cout);
+        }
+        return 0;
+    }
 
     std::filesystem::path scene_path(argv[1]);
     std::string output_path(argv[argc-1]);
@@ -14,14 +76,222 @@ int main(int argc, char* argv[]) {
     std::ifstream fin(scene_path);
     Setup setup = {6, uint16_t(std::atoi(argv[4]) / 2), Vec3<float>(), Vec3<float>(),
                     {uint16_t(std::atoi(argv[2])), uint16_t(std::atoi(argv[3]))}};
-    builder = GltfBuilder(fin, scene_path.parent_path(), std::move(setup));
-    Scene scene(std::move(builder));
-    std::cerr << "Scene parsed\n";
 
-    Image img = scene.render_scene();
-    std::cerr << "Scene rendered\n";
-    img.write_ppm(std::ofstream(output_path));
+    bool wavefront = false;
+    std::string sample_map_path;
+    std::string stats_path;
+    int workers = 0;
+    bool all_cameras = false;
+    bool numa = false;
+    std::string batch_path;
+    // options passed on to worker processes
+    std::vector<std::string> worker_options;
+    for (int i = 5; i < argc - 1; ++i) {
+        int first = i;
+        std::string opt(argv[i]);
+        auto value = [&] () -> std::string {
+            if (i + 1 >= argc - 1) {
+                throw std::logic_error("missing value for option " + opt);
+            }
+            return argv[++i];
+        };
+        if (opt == "--depth") {
+            setup.ray_depth = std::stoi(value());
+        } else if (opt == "--rr-depth") {
+            setup.rr_depth = std::stoi(value());
+        } else if (opt == "--sampler") {
+            setup.sequence = sequence_by_name(value());
+        } else if (opt == "--seed") {
+            setup.seed = std::stoul(value());
+        } else if (opt == "--adaptive") {
+            setup.adaptive_threshold = std::stof(value());
+        } else if (opt == "--time") {
+            setup.time_budget = std::stof(value());
+        } else if (opt == "--target-error") {
+            setup.target_error = std::stof(value());
+        } else if (opt == "--pass") {
+            int pass = std::stoi(value());
+            if (pass < 1 || pass > UINT16_MAX) {
+                throw std::logic_error("progressive pass must take from 1 to 65535 samples");
+            }
+            setup.pass_samples = pass;
+        } else if (opt == "--checkpoint") {
+            setup.checkpoint_path = value();
+        } else if (opt == "--checkpoint-interval") {
+            setup.checkpoint_interval = std::stof(value());
+        } else if (opt == "--resume") {
+            setup.resume = true;
+        } else if (opt == "--stats") {
+            stats_path = value();
+        } else if (opt == "--sample-map") {
+            sample_map_path = value();
+        } else if (opt == "--guiding") {
+            setup.guiding = true;
+        } else if (opt == "--wavefront") {
+            wavefront = true;
+        } else if (opt == "--samples") {
+            int samples = std::stoi(value());
+            if (samples < 0 || samples > UINT16_MAX) {
+                throw std::logic_error("--samples must be from 0 to 65535");
+            }
+            setup.samples = samples;
+        } else if (opt == "--first-sample") {
+            long long first = std::stoll(value());
+            if (first < 0 || first > UINT32_MAX) {
+                throw std::logic_error("--first-sample must be from 0 to 4294967295");
+            }
+            setup.first_sample = first;
+        } else if (opt == "--workers") {
+            workers = std::stoi(value());
+        } else if (opt == "--numa") {
+            numa = true;
+        } else if (opt == "--all-cameras") {
+            all_cameras = true;
+        } else if (opt == "--batch") {
+            batch_path = value();
+        } else {
+            throw std::logic_error("unknown option " + opt);
+        }
+        if (opt != "--workers" && opt != "--checkpoint" && opt != "--sample-map" && opt != "--samples" && opt != "--first-sample") {
+            worker_options.insert(worker_options.end(), argv + first, argv + i + 1);
+        }
+    }
+
+    if (setup.resume && setup.checkpoint_path.empty()) {
+        throw std::logic_error("--resume needs --checkpoint <path>");
+    }
+    if (!setup.checkpoint_path.empty() && wavefront) {
+        throw std::logic_error("wavefront renderer does not support checkpoints");
+    }
+
+    if (workers > 0 && (wavefront || !stats_path.empty() || setup.first_sample > 0)) {
+        throw std::logic_error("--workers can not be combined with --wavefront, --stats or --first-sample");
+    }
+
+    // scene is interleaved over nodes, samples accumulate in tile buffers
+    // allocated by pinned render threads, shared frame is written once per tile
+    NumaTopology topology;
+    if (numa) {
+        topology = NumaTopology::detect();
+        interleave_memory(topology);
+    }
+
+    if (all_cameras || !batch_path.empty()) {
+        if (workers > 0 || wavefront || setup.guiding || setup.adaptive_threshold > 0 || setup.time_budget > 0 ||
+            setup.target_error > 0 || !setup.checkpoint_path.empty() || !sample_map_path.empty()) {
+            throw std::logic_error("batch renders fixed spp with depth-first renderer, no sampling or output options");
+        }
+        auto [width, height] = setup.dimensions;
+        builder = GltfBuilder(fin, scene_path.parent_path(), std::move(setup));
+        std::vector<Camera> views;
+        std::vector<std::string> outputs;
+        if (all_cameras) {
+            views = builder.cameras;
+            outputs.resize(views.size());
+        } else {
+            json batch = json::parse(std::ifstream(batch_path));
+            for (const auto &entry : batch) {
+                views.push_back(read_camera(entry.value("camera", json::object()), builder.camera));
+                views.back().calc_fov_x(width, height);
+                outputs.push_back(entry.value("output", ""));
+            }
+        }
+        std::filesystem::path output(output_path);
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            if (outputs[i].empty()) {
+                outputs[i] = output.parent_path() / (output.stem().string() + '_' + std::to_string(i) + output.extension().string());
+            }
+        }
+        Scene scene(std::move(builder));
+        std::cerr << "Scene parsed\n";
+        if (numa) {
+            reset_memory_policy();
+            pin_threads(topology);
+        }
+
+        std::vector<Framebuffer> frames = scene.render_batch(views);
+        for (size_t i = 0; i < frames.size(); ++i) {
+            tonemap(frames[i]).write_ppm(std::ofstream(outputs[i]));
+            std::cerr << "Image dumped to " << outputs[i] << '\n';
+        }
+        if (!stats_path.empty()) {
+            std::ofstream(stats_path) << scene.stats.to_json().dump(4) << '\n';
+            std::cerr << "Stats dumped to " << stats_path << '\n';
+        }
+        return 0;
+    }
+
+    Framebuffer frame;
+    bool written = false;
+    if (workers > 0) {
+        // every worker checkpoints its range, parts are kept for resume
+        // only when render has checkpoint path
+        std::string base = setup.checkpoint_path.empty() ? output_path : setup.checkpoint_path;
+        // adaptive pixels may take up to 8 times their share
+        auto ranges = split_samples(setup.samples, workers, setup.adaptive_threshold > 0 ? 8 : 1);
+        std::vector<std::vector<std::string>> args;
+        std::vector<std::string> parts;
+        for (int i = 0; i < workers; ++i) {
+            parts.push_back(base + ".part" + std::to_string(i));
+            args.push_back({argv[0], argv[1], argv[2], argv[3], argv[4]});
+            args.back().insert(args.back().end(), worker_options.begin(), worker_options.end());
+            args.back().insert(args.back().end(), {"--samples", std::to_string(ranges[i].count),
+                                                    "--first-sample", std::to_string(ranges[i].first),
+                                                    "--checkpoint", parts.back(), "/dev/null"});
+        }
+        run_workers(args, max_threads());
+        frame = merge_partials(parts);
+        if (setup.checkpoint_path.empty()) {
+            for (auto &part : parts) {
+                std::filesystem::remove(part);
+            }
+        }
+        std::cerr << "Merged frames of " << workers << " workers\n";
+    } else {
+        builder = GltfBuilder(fin, scene_path.parent_path(), std::move(setup));
+        Scene scene(std::move(builder));
+        std::cerr << "Scene parsed\n";
+        if (numa) {
+            reset_memory_policy();
+            pin_threads(topology);
+        }
+
+        if (wavefront) {
+            frame = WavefrontRenderer(scene).render();
+        } else {
+            // tiles are tonemapped and written while others still render
+            auto [width, height] = scene.setup.dimensions;
+            TileWriter writer(output_path, width, height);
+            frame = scene.render_scene(&writer);
+            writer.finish();
+            written = true;
+        }
+        std::cerr << "Scene rendered\n";
+
+        if (!stats_path.empty()) {
+            std::ofstream(stats_path) << scene.stats.to_json().dump(4) << '\n';
+            std::cerr << "Stats dumped to " << stats_path << '\n';
+        }
+    }
+    if (!written) {
+        tonemap(frame).write_ppm(std::ofstream(output_path));
+    }
     std::cerr << "Image dumped to " << output_path << '\n';
 
+    if (!sample_map_path.empty()) {
+        uint32_t max_count = 1;
+        for (size_t i = 0; i < frame.size(); ++i) {
+            max_count = std::max(max_count, frame[i].count);
+        }
+        Image map(frame.width, frame.height);
+        for (uint16_t y = 0; y < frame.height; ++y) {
+            for (uint16_t x = 0; x < frame.width; ++x) {
+                map.set(x, y, Vec3<float>(1.f * frame.at(x, y).count / max_count));
+            }
+        }
+        map.write_ppm(std::ofstream(sample_map_path));
+        std::cerr << "Sample map dumped to " << sample_map_path << " (white is " << max_count << " samples)\n";
+    }
+
     return 0;
 }